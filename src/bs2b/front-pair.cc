@@ -0,0 +1 @@
+#include "../effect-common/front-pair.cc"
@@ -27,6 +27,10 @@
 
 #include <bs2b.h>
 
+#include "../effect-common/effect-params.h"
+#include "../effect-common/front-pair.h"
+#include "../effect-common/fused-effects.h"
+
 class BS2BPlugin : public EffectPlugin
 {
 public:
@@ -55,11 +59,26 @@ EXPORT BS2BPlugin aud_plugin_instance;
 static t_bs2bdp bs2b = nullptr;
 static int bs2b_channels;
 
+static void bs2b_process (float * data, int frames);
+static FusedStage bs2b_stage (aud_plugin_instance, bs2b_process);
+
 const char * const BS2BPlugin::defaults[] = {
  "feed", "45",
  "fcut", "700",
+ "multichannel", "FALSE",
  nullptr};
 
+/* feed and fcut are passed straight to libbs2b when they change */
+enum {
+    BS2B_MULTICHANNEL
+};
+
+static const EffectParam bs2b_param_list[] = {
+    {"multichannel", EffectParam::Bool}
+};
+
+static EffectParams bs2b_params ("bs2b", bs2b_param_list);
+
 bool BS2BPlugin::init ()
 {
     aud_config_set_defaults ("bs2b", defaults);
@@ -71,11 +90,15 @@ bool BS2BPlugin::init ()
     bs2b_set_level_feed (bs2b, aud_get_int ("bs2b", "feed"));
     bs2b_set_level_fcut (bs2b, aud_get_int ("bs2b", "fcut"));
 
+    bs2b_params.init ();
+    fused_register (bs2b_stage);
     return true;
 }
 
 void BS2BPlugin::cleanup ()
 {
+    fused_unregister (bs2b_stage);
+    bs2b_params.cleanup ();
     bs2b_close (bs2b);
     bs2b = nullptr;
 }
@@ -84,13 +107,24 @@ void BS2BPlugin::start (int & channels, int & rate)
 {
     bs2b_channels = channels;
     bs2b_set_srate (bs2b, rate);
+    fused_start (bs2b_stage, channels, rate);
 }
 
-Index<float> & BS2BPlugin::process (Index<float> & data)
+static void bs2b_cross_feed (float * data, int frames)
 {
-    if (bs2b_channels == 2)
-        bs2b_cross_feed_f (bs2b, data.begin (), data.len () / 2);
+    bs2b_cross_feed_f (bs2b, data, frames);
+}
 
+static void bs2b_process (float * data, int frames)
+{
+    if (bs2b_channels == 2 || (bs2b_params.get_bool (BS2B_MULTICHANNEL) &&
+     front_pair_layout (bs2b_channels)))
+        front_pair_process (data, bs2b_channels, frames, bs2b_cross_feed);
+}
+
+Index<float> & BS2BPlugin::process (Index<float> & data)
+{
+    fused_process (bs2b_stage, data);
     return data;
 }
 
@@ -104,6 +138,11 @@ static void fcut_value_changed ()
     bs2b_set_level_fcut (bs2b, aud_get_int ("bs2b", "fcut"));
 }
 
+static void multichannel_changed ()
+{
+    effect_settings_changed ("bs2b");
+}
+
 static void set_preset (uint32_t preset)
 {
     int feed = preset >> 16;
@@ -139,7 +178,9 @@ const PreferencesWidget BS2BPlugin::widgets[] = {
     WidgetSpin (N_("Cut frequency:"),
         WidgetInt ("bs2b", "fcut", fcut_value_changed, "bs2b preset loaded"),
         {BS2B_MINFCUT, BS2B_MAXFCUT, 1, N_("Hz")}),
-    WidgetBox ({{preset_widgets}, true})
+    WidgetBox ({{preset_widgets}, true}),
+    WidgetCheck (N_("Apply to front left/right of surround audio"),
+        WidgetBool ("bs2b", "multichannel", multichannel_changed))
 };
 
 const PluginPreferences BS2BPlugin::prefs = {{widgets}};
@@ -28,27 +28,77 @@
 #include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
+#include "../effect-common/effect-latency.h"
+#include "../effect-common/effect-params.h"
+
 /* Response time adjustments.  Maybe this should be adjustable? */
 #define CHUNK_TIME 0.2f /* seconds */
 #define CHUNKS 5
 #define DECAY 0.3f
 
+/* Lookahead mode works in blocks of at most this many frames */
+#define LOOKAHEAD_BLOCK 64
+
+#define MAX_LOOKAHEAD 100 /* milliseconds */
+
 /* What is a "normal" volume?  Replay Gain stuff claims to use 89 dB, but what
  * does that translate to in our PCM range? */
 static const char * const compressor_defaults[] = {
     "center", "0.5",
     "range", "0.5",
-     nullptr
+    "lookahead_mode", "FALSE",
+    "lookahead", "10",
+    "attack", "10",
+    "release", "300",
+    nullptr
 };
 
+enum {
+    PARAM_CENTER,
+    PARAM_RANGE,
+    PARAM_LOOKAHEAD_MODE,
+    PARAM_LOOKAHEAD,
+    PARAM_ATTACK,
+    PARAM_RELEASE
+};
+
+static const EffectParam compressor_param_list[] = {
+    {"center", EffectParam::Float},
+    {"range", EffectParam::Float},
+    {"lookahead_mode", EffectParam::Bool},
+    {"lookahead", EffectParam::Int},
+    {"attack", EffectParam::Int},
+    {"release", EffectParam::Int}
+};
+
+static EffectParams compressor_params ("compressor", compressor_param_list);
+
+static void compressor_changed ()
+    { effect_settings_changed ("compressor"); }
+
 static const PreferencesWidget compressor_widgets[] = {
     WidgetLabel (N_("<b>Compression</b>")),
     WidgetSpin (N_("Center volume:"),
-        WidgetFloat ("compressor", "center"),
+        WidgetFloat ("compressor", "center", compressor_changed),
         {0.1, 1, 0.1}),
     WidgetSpin (N_("Dynamic range:"),
-        WidgetFloat ("compressor", "range"),
-        {0.0, 3.0, 0.1})
+        WidgetFloat ("compressor", "range", compressor_changed),
+        {0.0, 3.0, 0.1}),
+    WidgetLabel (N_("<b>Latency</b>")),
+    WidgetCheck (N_("Low-latency lookahead mode"),
+        WidgetBool ("compressor", "lookahead_mode", compressor_changed)),
+    WidgetSpin (N_("Lookahead:"),
+        WidgetInt ("compressor", "lookahead", compressor_changed),
+        {1, MAX_LOOKAHEAD, 1, N_("ms")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Attack:"),
+        WidgetInt ("compressor", "attack", compressor_changed),
+        {1, 1000, 1, N_("ms")},
+        WIDGET_CHILD),
+    WidgetSpin (N_("Release:"),
+        WidgetInt ("compressor", "release", compressor_changed),
+        {10, 5000, 10, N_("ms")},
+        WIDGET_CHILD)
 };
 
 static const PluginPreferences compressor_prefs = {{compressor_widgets}};
@@ -92,6 +142,29 @@ static int chunk_size;
 static float current_peak;
 static int current_channels, current_rate;
 
+/* In lookahead mode, the ring buffer is instead a delay line of <lookahead>
+ * frames.  The gain is chosen from the true peak of every frame in the delay
+ * line, which is tracked with a monotonic queue: a frame whose peak is lower
+ * than that of some later frame can never be the maximum again and is dropped,
+ * so the queue is always in decreasing order and its head is the maximum. */
+
+static bool lookahead_mode;
+static int lookahead, window;
+static float attack_frames, release_frames;
+static float current_gain;
+static int64_t frames_in;
+
+static Index<float> window_peaks;
+static Index<int64_t> window_frames;
+static int window_head, window_len;
+
+static EffectLatency latency (aud_plugin_instance, "compressor");
+
+static void update_latency ()
+{
+    latency.set (buffer.len () / current_channels, current_rate);
+}
+
 /* I used to find the maximum sample and take that as the peak, but that doesn't
  * work well on badly clipped tracks.  Now, I use the highly sophisticated
  * method of averaging the absolute value of the samples and multiplying by 6, a
@@ -111,8 +184,8 @@ static float calc_peak (float * data, int length)
 
 static void do_ramp (float * data, int length, float peak_a, float peak_b)
 {
-    float center = aud_get_double ("compressor", "center");
-    float range = aud_get_double ("compressor", "range");
+    float center = compressor_params.get (PARAM_CENTER);
+    float range = compressor_params.get (PARAM_RANGE);
     float a = powf (peak_a / center, range - 1);
     float b = powf (peak_b / center, range - 1);
 
@@ -123,17 +196,120 @@ static void do_ramp (float * data, int length, float peak_a, float peak_b)
     }
 }
 
+static void window_push (int64_t frame, float peak)
+{
+    int size = window_peaks.len ();
+
+    /* drop frames that have left the window */
+    while (window_len && window_frames[window_head] <= frame - window)
+    {
+        window_head = (window_head + 1) % size;
+        window_len --;
+    }
+
+    /* drop frames that can no longer be the maximum */
+    while (window_len)
+    {
+        int tail = (window_head + window_len - 1) % size;
+        if (window_peaks[tail] > peak)
+            break;
+
+        window_len --;
+    }
+
+    int tail = (window_head + window_len) % size;
+    window_peaks[tail] = peak;
+    window_frames[tail] = frame;
+    window_len ++;
+}
+
+static float window_max ()
+{
+    return window_len ? window_peaks[window_head] : 0.0f;
+}
+
+/* multiplies <data> by a gain ramping linearly from <a> to <b> */
+static void apply_ramp (float * data, int length, float a, float b)
+{
+    float step = (b - a) / length;
+
+    for (int i = 0; i < length; i ++)
+        data[i] *= a + step * i;
+}
+
+static void lookahead_block (const float * data, int frames)
+{
+    for (int f = 0; f < frames; f ++)
+    {
+        float peak = 0;
+        for (int c = 0; c < current_channels; c ++)
+            peak = aud::max (peak, fabsf (data[c]));
+
+        window_push (frames_in ++, peak);
+        data += current_channels;
+    }
+
+    float center = compressor_params.get (PARAM_CENTER);
+    float range = compressor_params.get (PARAM_RANGE);
+
+    float peak = window_max ();
+    float target = powf (aud::max (0.01f, peak) / center, range - 1);
+
+    float time = (target < current_gain) ? attack_frames : release_frames;
+    float new_gain = current_gain + (target - current_gain) * (1.0f - expf (-frames / time));
+
+    /* The window covers both the frames about to be output and those up to
+     * <lookahead> frames later, so neither end of the ramp can clip. */
+    if (peak > 0)
+        new_gain = aud::min (new_gain, 1.0f / peak);
+
+    int ready = buffer.len () - lookahead * current_channels;
+
+    while (ready > 0)
+    {
+        int linear = aud::min (ready, buffer.linear ());
+        float end_gain = current_gain + (new_gain - current_gain) * linear / ready;
+
+        apply_ramp (& buffer[0], linear, current_gain, end_gain);
+        buffer.move_out (output, -1, linear);
+
+        current_gain = end_gain;
+        ready -= linear;
+    }
+
+    current_gain = new_gain;
+}
+
+static void lookahead_process (const float * data, int length)
+{
+    int block = aud::min (LOOKAHEAD_BLOCK, lookahead) * current_channels;
+
+    for (int offset = 0; offset < length; offset += block)
+    {
+        int copy = aud::min (block, length - offset);
+
+        buffer.copy_in (data + offset, copy);
+        lookahead_block (data + offset, copy / current_channels);
+    }
+}
+
 bool Compressor::init ()
 {
     aud_config_set_defaults ("compressor", compressor_defaults);
+    compressor_params.init ();
+    latency.init ();
     return true;
 }
 
 void Compressor::cleanup ()
 {
+    compressor_params.cleanup ();
+    latency.cleanup ();
     buffer.destroy ();
     peaks.destroy ();
     output.clear ();
+    window_peaks.clear ();
+    window_frames.clear ();
 }
 
 void Compressor::start (int & channels, int & rate)
@@ -141,10 +317,30 @@ void Compressor::start (int & channels, int & rate)
     current_channels = channels;
     current_rate = rate;
 
-    chunk_size = channels * (int) (rate * CHUNK_TIME);
+    lookahead_mode = compressor_params.get_bool (PARAM_LOOKAHEAD_MODE);
+
+    buffer.discard ();
+
+    if (lookahead_mode)
+    {
+        int ms = aud::clamp (compressor_params.get_int (PARAM_LOOKAHEAD), 1, MAX_LOOKAHEAD);
+
+        lookahead = aud::max (1, aud::rescale (ms, 1000, rate));
+        window = lookahead + LOOKAHEAD_BLOCK;
+        attack_frames = aud::max (1.0f, compressor_params.get_int (PARAM_ATTACK) * rate / 1000.0f);
+        release_frames = aud::max (1.0f, compressor_params.get_int (PARAM_RELEASE) * rate / 1000.0f);
+
+        buffer.alloc ((lookahead + LOOKAHEAD_BLOCK) * channels);
+        window_peaks.resize (window + 1);
+        window_frames.resize (window + 1);
+    }
+    else
+    {
+        chunk_size = channels * (int) (rate * CHUNK_TIME);
 
-    buffer.alloc (chunk_size * CHUNKS);
-    peaks.alloc (CHUNKS);
+        buffer.alloc (chunk_size * CHUNKS);
+        peaks.alloc (CHUNKS);
+    }
 
     flush (true);
 }
@@ -153,6 +349,13 @@ Index<float> & Compressor::process (Index<float> & data)
 {
     output.resize (0);
 
+    if (lookahead_mode)
+    {
+        lookahead_process (data.begin (), data.len ());
+        update_latency ();
+        return output;
+    }
+
     int offset = 0;
     int remain = data.len ();
 
@@ -190,6 +393,7 @@ Index<float> & Compressor::process (Index<float> & data)
         peaks.pop ();
     }
 
+    update_latency ();
     return output;
 }
 
@@ -199,6 +403,12 @@ bool Compressor::flush (bool force)
     peaks.discard ();
 
     current_peak = 0.0f;
+
+    current_gain = 1.0f;
+    frames_in = 0;
+    window_head = window_len = 0;
+
+    update_latency ();
     return true;
 }
 
@@ -206,6 +416,22 @@ Index<float> & Compressor::finish (Index<float> & data, bool end_of_playlist)
 {
     output.resize (0);
 
+    if (lookahead_mode)
+    {
+        lookahead_process (data.begin (), data.len ());
+
+        while (buffer.len ())
+        {
+            int linear = buffer.linear ();
+
+            apply_ramp (& buffer[0], linear, current_gain, current_gain);
+            buffer.move_out (output, -1, linear);
+        }
+
+        update_latency ();
+        return output;
+    }
+
     peaks.discard ();
 
     while (buffer.len ())
@@ -223,10 +449,11 @@ Index<float> & Compressor::finish (Index<float> & data, bool end_of_playlist)
 
     output.insert (data.begin (), -1, data.len ());
 
+    update_latency ();
     return output;
 }
 
 int Compressor::adjust_delay (int delay)
 {
-    return delay + aud::rescale<int64_t> (buffer.len () / current_channels, current_rate, 1000);
+    return latency.adjust_delay (delay);
 }
@@ -17,11 +17,18 @@
  * the use of this software.
  */
 
+#include <math.h>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
+#include <libaudcore/ringbuf.h>
 #include <libaudcore/runtime.h>
 
+#include "../effect-common/channel-matrix.h"
+#include "../effect-common/effect-latency.h"
+#include "../effect-common/song-info.h"
+
 enum
 {
     STATE_OFF,
@@ -36,6 +43,7 @@ static const char * const crossfade_defaults[] = {
     "length", "5",
     "manual", "TRUE",
     "manual_length", "0.2",
+    "skip_silence", "FALSE",
     nullptr
 };
 
@@ -57,9 +65,12 @@ static const PreferencesWidget crossfade_widgets[] = {
         WidgetFloat ("crossfade", "manual_length"),
         {0.1, 3.0, 0.1, N_("seconds")},
         WIDGET_CHILD),
-    WidgetLabel (N_("<b>Tip</b>")),
-    WidgetLabel (N_("For better crossfading, enable\n"
-                    "the Silence Removal effect."))
+    WidgetLabel (N_("<b>Silence</b>")),
+    WidgetCheck (N_("Skip silence at the start and end of songs"),
+        WidgetBool ("crossfade", "skip_silence")),
+    WidgetLabel (N_("Songs are measured the first time they are\n"
+                    "played through, and trimmed from then on."),
+        WIDGET_CHILD)
 };
 
 static const PluginPreferences crossfade_prefs = {{crossfade_widgets}};
@@ -91,77 +102,499 @@ EXPORT Crossfade aud_plugin_instance;
 
 static char state = STATE_OFF;
 static int current_channels, current_rate;
-static Index<float> buffer, output;
-static int fadein_point;
+static RingBuf<float> buffer;
+static Index<float> output, scratch;
+static int fadein_point, fadeout_length;
+
+/* The fade-out ramp is not applied to the buffer up front.  Instead, the part
+ * of the buffer from fadein_point to fadeout_length is understood to still need
+ * it, and it is applied lazily as the buffer is mixed with the next song or
+ * read out. */
+
+/* When the next song has a different format, the buffer is not converted all at
+ * once.  Instead, the first conv_pending samples of the buffer are understood to
+ * be still in the old format, and they are converted a piece at a time as they
+ * are mixed with the next song.  Converted samples are appended to the end of
+ * the buffer, so that once the conversion is complete, the buffer is in order
+ * again.  The conversion consists of a channel matrix, followed by a windowed
+ * sinc interpolator with a table of precomputed phases. */
+
+#define CONV_HALF_TAPS 16
+#define CONV_PHASES 64
+#define CONV_CHUNK 4096 /* frames */
+
+static int conv_channels, conv_rate;
+static int conv_pending;
+static int64_t conv_in_frames, conv_out_frames;
+static int64_t conv_done, conv_pulled, conv_hist_start;
+static int conv_width;
+static Index<float> conv_matrix, conv_filter, conv_hist, conv_raw, conv_taps;
+
+/* Silence at the start and end of each song is measured as the song plays,
+ * and cached at its end (see song-info.h).  When a song whose silence is
+ * known comes up again, the silence is cut out as it arrives, and since the
+ * point where the song fades out is then known in advance, only the overlap
+ * itself is held back, once the song gets there, rather than a whole overlap
+ * all through the song.  This stands in for the Silence Removal effect, which
+ * has to hold back the silence before it knows where it ends. */
+
+#define SILENCE_LEVEL 0.003f /* -50 dBFS */
+
+static const char * const cache_keys[] = {"rate", "frames", "lead", "tail"};
+
+enum {
+    VALUE_RATE,
+    VALUE_FRAMES,
+    VALUE_LEAD,  /* frames of silence at the start */
+    VALUE_TAIL   /* frames of silence at the end */
+};
+
+static SongInfo song;
+static bool whole_song;    /* song_pos counts from the start of the song */
+static int64_t song_pos;   /* input frames so far, including any cut out */
+static int64_t first_sound, last_sound; /* -1 until there is any sound */
+
+static EffectLatency latency (aud_plugin_instance, "crossfade");
 
 bool Crossfade::init ()
 {
     aud_config_set_defaults ("crossfade", crossfade_defaults);
+    latency.init ();
+    song_info_init ("crossfade-cache", cache_keys);
     return true;
 }
 
+static void reset_conversion ()
+{
+    conv_pending = 0;
+    conv_matrix.clear ();
+    conv_filter.clear ();
+    conv_hist.clear ();
+    conv_raw.clear ();
+    conv_taps.clear ();
+}
+
 void Crossfade::cleanup ()
 {
+    song_info_cleanup ();
+    latency.cleanup ();
+
     state = STATE_OFF;
-    buffer.clear ();
+    buffer.destroy ();
     output.clear ();
+    scratch.clear ();
+    reset_conversion ();
+}
+
+/* returns a pointer to the sample at <pos> in the ring buffer and reduces <len>
+ * so that the span starting there does not wrap around */
+static float * get_span (int pos, int & len)
+{
+    int linear = buffer.linear ();
+    int avail = (pos < linear) ? linear - pos : buffer.len () - pos;
+
+    len = aud::min (len, avail);
+    return & buffer[pos];
 }
 
-static void do_ramp (float * data, int length, float a, float b)
+/* applies the fade-out ramp to <data>, which begins at <pos> in the fade */
+static void fadeout_span (float * data, int pos, int len)
 {
-    for (int i = 0; i < length; i ++)
+    float scale = 1.0f / fadeout_length;
+
+    for (int i = 0; i < len; i ++)
+        data[i] *= (fadeout_length - (pos + i)) * scale;
+}
+
+/* mixes the faded-in <add> into the fading-out <data>, beginning at <pos> */
+static void crossfade_span (float * data, const float * add, int pos, int len)
+{
+    float scale = 1.0f / fadeout_length;
+
+    for (int i = 0; i < len; i ++)
+        data[i] += (add[i] - data[i]) * ((pos + i) * scale);
+}
+
+/* applies the fade-out ramp to buffer samples [pos, pos + len) */
+static void do_fadeout (int pos, int len)
+{
+    while (len > 0)
     {
-        * data = (* data) * (a * (length - i) + b * i) / length;
-        data ++;
+        int span = len;
+        float * data = get_span (pos, span);
+        fadeout_span (data, pos, span);
+
+        pos += span;
+        len -= span;
     }
 }
 
-static void mix (float * data, float * add, int length)
+/* mixes the faded-in <add> into the buffer, starting at <pos> */
+static void do_crossfade (int pos, const float * add, int len)
 {
-    while (length --)
-        (* data ++) += (* add ++);
+    while (len > 0)
+    {
+        int span = len;
+        float * data = get_span (pos, span);
+        crossfade_span (data, add, pos, span);
+
+        pos += span;
+        add += span;
+        len -= span;
+    }
+}
+
+static void buffer_append (const float * data, int len)
+{
+    if (buffer.space () < len)
+        buffer.alloc (aud::max (buffer.len () + len, buffer.size () * 2));
+
+    buffer.copy_in (data, len);
+}
+
+static void buffer_append_silence (int len)
+{
+    static const float zeroes[1024] = {};
+
+    while (len > 0)
+    {
+        int copy = aud::min (len, aud::n_elems (zeroes));
+        buffer_append (zeroes, copy);
+        len -= copy;
+    }
+}
+
+/* discards all but the first <len> samples in the buffer */
+static void buffer_truncate (int len)
+{
+    if (buffer.len () <= len)
+        return;
+
+    scratch.resize (0);
+    buffer.move_out (scratch, -1, len);
+    buffer.discard ();
+    buffer.copy_in (scratch.begin (), len);
+}
+
+static double conv_window (double x)
+{
+    /* Blackman window over [-1, 1] */
+    return 0.42 + 0.5 * cos (M_PI * x) + 0.08 * cos (2 * M_PI * x);
+}
+
+static void build_conv_filter ()
+{
+    /* lower the cutoff when downsampling to avoid aliasing */
+    double cutoff = 0.95 * aud::min (1.0, (double) current_rate / conv_rate);
+
+    conv_width = (int) ceil (CONV_HALF_TAPS / cutoff);
+    conv_filter.resize ((CONV_PHASES + 1) * 2 * conv_width);
+    conv_taps.resize (2 * conv_width);
+
+    for (int p = 0; p <= CONV_PHASES; p ++)
+    {
+        float * row = & conv_filter[p * 2 * conv_width];
+        double sum = 0;
+
+        for (int j = 0; j < 2 * conv_width; j ++)
+        {
+            /* distance from the interpolated point, in input frames */
+            double x = (j - conv_width + 1) - (double) p / CONV_PHASES;
+            double y = cutoff * x;
+            double sinc = (y == 0) ? 1 : sin (M_PI * y) / (M_PI * y);
+
+            row[j] = sinc * conv_window (x / conv_width);
+            sum += row[j];
+        }
+
+        /* normalize for unity gain at DC */
+        for (int j = 0; j < 2 * conv_width; j ++)
+            row[j] /= sum;
+    }
+}
+
+/* sets up conversion of the whole buffer from the current format */
+static void begin_conversion (int channels, int rate)
+{
+    conv_channels = current_channels;
+    conv_rate = current_rate;
+    conv_pending = buffer.len ();
+
+    conv_in_frames = buffer.len () / conv_channels;
+    conv_out_frames = conv_in_frames * rate / conv_rate;
+    conv_done = conv_pulled = conv_hist_start = 0;
+
+    current_channels = channels;
+    current_rate = rate;
+
+    conv_matrix = channel_matrix (conv_channels, current_channels);
+    conv_hist.resize (0);
+
+    if (current_rate != conv_rate)
+        build_conv_filter ();
+    else
+        conv_width = 1;
+}
+
+/* moves input frames [conv_pulled, end) from the buffer into the history,
+ * converting them to the new channel layout on the way */
+static void pull_frames (int64_t end)
+{
+    int frames = end - conv_pulled;
+    if (frames <= 0)
+        return;
+
+    conv_raw.resize (frames * conv_channels);
+    buffer.move_out (conv_raw.begin (), conv_raw.len ());
+    conv_pending -= conv_raw.len ();
+
+    int old_len = conv_hist.len ();
+    conv_hist.insert (-1, frames * current_channels);
+    channel_matrix_apply (conv_matrix.begin (), conv_channels, current_channels,
+     conv_raw.begin (), & conv_hist[old_len], frames);
+
+    conv_pulled = end;
+}
+
+static const float * hist_frame (int64_t frame)
+{
+    frame = aud::clamp<int64_t> (frame, 0, conv_in_frames - 1);
+    return & conv_hist[(frame - conv_hist_start) * current_channels];
+}
+
+/* writes the next <frames> converted frames to <out> */
+static void convert_frames (float * out, int frames)
+{
+    if (! frames)
+        return;
+
+    int64_t last = (conv_done + frames - 1) * conv_rate / current_rate;
+
+    pull_frames (aud::min (last + conv_width + 1, conv_in_frames));
+
+    for (int f = 0; f < frames; f ++)
+    {
+        int64_t pos = (conv_done + f) * conv_rate;
+        int64_t frame = pos / current_rate;
+
+        if (current_rate == conv_rate)
+        {
+            const float * in = hist_frame (frame);
+            for (int c = 0; c < current_channels; c ++)
+                * out ++ = in[c];
+
+            continue;
+        }
+
+        /* interpolate between the two nearest precomputed phases */
+        float phase = (float) (pos % current_rate) * CONV_PHASES / current_rate;
+        int p = aud::min ((int) phase, CONV_PHASES - 1);
+        float frac = phase - p;
+
+        const float * row0 = & conv_filter[p * 2 * conv_width];
+        const float * row1 = row0 + 2 * conv_width;
+
+        for (int j = 0; j < 2 * conv_width; j ++)
+            conv_taps[j] = row0[j] + (row1[j] - row0[j]) * frac;
+
+        for (int c = 0; c < current_channels; c ++)
+            out[c] = 0;
+
+        for (int j = 0; j < 2 * conv_width; j ++)
+        {
+            const float * in = hist_frame (frame - conv_width + 1 + j);
+            for (int c = 0; c < current_channels; c ++)
+                out[c] += in[c] * conv_taps[j];
+        }
+
+        out += current_channels;
+    }
+
+    conv_done += frames;
+
+    /* drop history that is no longer needed */
+    int64_t keep = aud::clamp<int64_t> (last - conv_width + 1, 0, conv_pulled);
+    if (keep > conv_hist_start)
+    {
+        conv_hist.remove (0, (keep - conv_hist_start) * current_channels);
+        conv_hist_start = keep;
+    }
+}
+
+/* discards what is left of the old-format input after conversion */
+static void end_conversion ()
+{
+    buffer.discard (conv_pending);
+    reset_conversion ();
+}
+
+/* converts the remainder of the buffer to the new format */
+static void convert_all ()
+{
+    while (conv_done < conv_out_frames)
+    {
+        int frames = aud::min<int64_t> (conv_out_frames - conv_done, CONV_CHUNK);
+
+        scratch.resize (frames * current_channels);
+        convert_frames (scratch.begin (), frames);
+        buffer_append (scratch.begin (), scratch.len ());
+    }
+
+    end_conversion ();
+}
+
+/* applies whatever part of the fade-out ramp has not yet been applied */
+static void settle_fadeout ()
+{
+    if (conv_pending)
+    {
+        while (fadein_point < fadeout_length)
+        {
+            int copy = aud::min (fadeout_length - fadein_point, CONV_CHUNK * current_channels);
+
+            scratch.resize (copy);
+            convert_frames (scratch.begin (), copy / current_channels);
+            fadeout_span (scratch.begin (), fadein_point, copy);
+            buffer_append (scratch.begin (), copy);
+
+            fadein_point += copy;
+        }
+
+        end_conversion ();
+    }
+    else if (fadein_point < fadeout_length)
+        do_fadeout (fadein_point, fadeout_length - fadein_point);
+
+    fadein_point = fadeout_length = 0;
 }
 
-/* stupid simple resampling/rechanneling algorithm */
 static void reformat (int channels, int rate)
 {
     if (channels == current_channels && rate == current_rate)
         return;
 
-    int old_frames = buffer.len () / current_channels;
-    int new_frames = (int64_t) old_frames * rate / current_rate;
+    if (conv_pending)
+        convert_all ();
+
+    if (buffer.len ())
+        begin_conversion (channels, rate);
+}
+
+static void reset_song ()
+{
+    song_pos = 0;
+    first_sound = last_sound = -1;
+}
+
+static void update_song ()
+{
+    int playing = song.song;
+
+    /* a song other than the one expected, or one started by hand, which
+     * song_pos has counted since the end of the last song or the flush */
+    if (song_info_update (song) && playing >= 0 && song.song != playing)
+        whole_song = true;
+}
+
+/* gets the part of the playing song that is not silence, if it is known */
+static bool song_bounds (int64_t & begin, int64_t & end)
+{
+    if (! whole_song || ! song.known || song.values[VALUE_RATE] != current_rate ||
+     ! aud_get_bool ("crossfade", "skip_silence"))
+        return false;
+
+    begin = song.values[VALUE_LEAD];
+    end = song.values[VALUE_FRAMES] - song.values[VALUE_TAIL];
+    return begin < end;
+}
+
+static int find_sound (const float * data, int len)
+{
+    for (int i = 0; i < len; i ++)
+    {
+        if (fabsf (data[i]) > SILENCE_LEVEL)
+            return i;
+    }
+
+    return -1;
+}
+
+static int find_last_sound (const float * data, int len)
+{
+    for (int i = len; i --; )
+    {
+        if (fabsf (data[i]) > SILENCE_LEVEL)
+            return i;
+    }
+
+    return -1;
+}
+
+/* measures the silence in <data> and cuts it out, if the song is known */
+static void trim_silence (Index<float> & data)
+{
+    int frames = data.len () / current_channels;
+    int64_t pos = song_pos;
 
-    int map[AUD_MAX_CHANNELS];
-    for (int c = 0; c < channels; c ++)
-        map[c] = c * current_channels / channels;
+    if (! frames)
+        return;
 
-    Index<float> new_buffer;
-    new_buffer.resize (new_frames * channels);
+    song_pos += frames;
 
-    for (int f = 0; f < new_frames; f ++)
+    int last = find_last_sound (data.begin (), data.len ());
+    if (last >= 0)
     {
-        int f0 = (int64_t) f * current_rate / rate;
-        int s0 = f0 * current_channels;
-        int s = f * channels;
+        last_sound = pos + last / current_channels + 1;
 
-        for (int c = 0; c < channels; c ++)
-            new_buffer[s + c] = buffer[s0 + map[c]];
+        if (first_sound < 0)
+            first_sound = pos + find_sound (data.begin (), data.len ()) / current_channels;
     }
 
-    buffer = std::move (new_buffer);
+    int64_t begin, end;
+    if (! song_bounds (begin, end))
+        return;
+
+    int keep = aud::clamp<int64_t> (end - pos, 0, frames);
+    int skip = aud::clamp<int64_t> (begin - pos, 0, keep);
+
+    data.resize (keep * current_channels);
+    data.remove (0, skip * current_channels);
+}
+
+/* stores the silence measured in the song that has just ended */
+static void finish_song ()
+{
+    int64_t lead = (first_sound < 0) ? song_pos : first_sound;
+    int64_t tail = (last_sound < 0) ? 0 : song_pos - last_sound;
+
+    double values[] = {(double) current_rate, (double) song_pos, (double) lead, (double) tail};
+
+    bool store = whole_song && ! song.known && song_pos > 0 &&
+     aud_get_bool ("crossfade", "skip_silence");
+
+    song_info_finish (store ? values : nullptr);
+
+    whole_song = true;
+    reset_song ();
 }
 
 static int buffer_needed_for_state ()
 {
-    double overlap = 0;
+    int frames = 0;
+    int64_t begin, end;
 
     if (state != STATE_FLUSHED && aud_get_bool ("crossfade", "automatic"))
-        overlap = aud_get_double ("crossfade", "length");
+        frames = current_rate * aud_get_double ("crossfade", "length");
+
+    /* with the end of the song known, hold back only what has been received
+     * of the overlap before it */
+    if (state == STATE_RUNNING && frames && song_bounds (begin, end))
+        frames = aud::clamp<int64_t> (aud::min (song_pos, end) - (end - frames), 0, frames);
 
     if (state != STATE_FINISHED && aud_get_bool ("crossfade", "manual"))
-        overlap = aud::max (overlap, aud_get_double ("crossfade", "manual_length"));
+        frames = aud::max (frames, (int) (current_rate * aud_get_double ("crossfade", "manual_length")));
 
-    return current_channels * (int) (current_rate * overlap);
+    return current_channels * frames;
 }
 
 static void output_data_as_ready (int buffer_needed, bool exact)
@@ -170,7 +603,37 @@ static void output_data_as_ready (int buffer_needed, bool exact)
 
     /* if allowed, wait until we have at least 1/2 second ready to output */
     if (exact ? (copy > 0) : (copy >= current_channels * (current_rate / 2)))
-        output.move_from (buffer, 0, -1, copy, true, true);
+        buffer.move_out (output, -1, copy);
+}
+
+/* outputs the entire buffer, applying the fade-out ramp on the way */
+static void output_faded_out ()
+{
+    int length = buffer.len ();
+    float scale = 1.0f / length;
+
+    for (int done = 0; done < length; )
+    {
+        int copy = buffer.linear ();
+        float * data = & buffer[0];
+
+        for (int i = 0; i < copy; i ++)
+            data[i] *= (length - (done + i)) * scale;
+
+        buffer.move_out (output, -1, copy);
+        done += copy;
+    }
+}
+
+static void update_latency ()
+{
+    int frames = (buffer.len () - conv_pending) / current_channels;
+
+    /* samples not yet converted are still at the old rate */
+    if (conv_pending)
+        frames += lround ((double) (conv_pending / conv_channels) * current_rate / conv_rate);
+
+    latency.set (frames, current_rate);
 }
 
 void Crossfade::start (int & channels, int & rate)
@@ -181,45 +644,59 @@ void Crossfade::start (int & channels, int & rate)
     current_channels = channels;
     current_rate = rate;
 
+    whole_song = true;
+    reset_song ();
+
     if (state == STATE_OFF)
     {
         if (aud_get_bool ("crossfade", "manual"))
         {
             state = STATE_FLUSHED;
-            buffer.insert (0, buffer_needed_for_state ());
+            buffer_append_silence (buffer_needed_for_state ());
         }
         else
             state = STATE_RUNNING;
     }
+
+    update_latency ();
 }
 
 static void run_fadeout ()
 {
-    do_ramp (buffer.begin (), buffer.len (), 1.0, 0.0);
-
     state = STATE_FADEIN;
     fadein_point = 0;
+    fadeout_length = conv_pending ? conv_out_frames * current_channels : buffer.len ();
 }
 
 static void run_fadein (Index<float> & data)
 {
-    int length = buffer.len ();
-
-    if (fadein_point < length)
+    if (fadein_point < fadeout_length)
     {
-        int copy = aud::min (data.len (), length - fadein_point);
-        float a = (float) fadein_point / length;
-        float b = (float) (fadein_point + copy) / length;
+        int copy = aud::min (data.len (), fadeout_length - fadein_point);
+
+        if (conv_pending)
+        {
+            scratch.resize (copy);
+            convert_frames (scratch.begin (), copy / current_channels);
+            crossfade_span (scratch.begin (), data.begin (), fadein_point, copy);
+            buffer_append (scratch.begin (), copy);
+        }
+        else
+            do_crossfade (fadein_point, data.begin (), copy);
 
-        do_ramp (data.begin (), copy, a, b);
-        mix (& buffer[fadein_point], data.begin (), copy);
         data.remove (0, copy);
 
         fadein_point += copy;
     }
 
-    if (fadein_point == length)
+    if (fadein_point == fadeout_length)
+    {
+        if (conv_pending)
+            end_conversion ();
+
         state = STATE_RUNNING;
+        fadein_point = fadeout_length = 0;
+    }
 }
 
 Index<float> & Crossfade::process (Index<float> & data)
@@ -227,6 +704,9 @@ Index<float> & Crossfade::process (Index<float> & data)
     if (state == STATE_OFF)
         return data;
 
+    update_song ();
+    trim_silence (data);
+
     output.resize (0);
 
     if (state == STATE_FINISHED || state == STATE_FLUSHED)
@@ -237,31 +717,43 @@ Index<float> & Crossfade::process (Index<float> & data)
 
     if (state == STATE_RUNNING)
     {
-        buffer.insert (data.begin (), -1, data.len ());
+        buffer_append (data.begin (), data.len ());
         output_data_as_ready (buffer_needed_for_state (), false);
     }
 
+    update_latency ();
     return output;
 }
 
 bool Crossfade::flush (bool force)
 {
+    /* after a seek, the position in the song is no longer known */
+    whole_song = false;
+    reset_song ();
+
     if (state == STATE_OFF)
         return true;
 
     if (! force && aud_get_bool ("crossfade", "manual"))
     {
+        if (state == STATE_FADEIN)
+            settle_fadeout ();
+        else if (conv_pending)
+            convert_all ();
+
         state = STATE_FLUSHED;
-        int buffer_needed = buffer_needed_for_state ();
-        if (buffer.len () > buffer_needed)
-            buffer.remove (buffer_needed, -1);
+        buffer_truncate (buffer_needed_for_state ());
 
+        update_latency ();
         return false;
     }
 
     state = STATE_RUNNING;
-    buffer.resize (0);
+    buffer.discard ();
+    fadein_point = fadeout_length = 0;
+    reset_conversion ();
 
+    update_latency ();
     return true;
 }
 
@@ -270,19 +762,28 @@ Index<float> & Crossfade::finish (Index<float> & data, bool end_of_playlist)
     if (state == STATE_OFF)
         return data;
 
+    update_song ();
+    trim_silence (data);
+
     output.resize (0);
 
     if (state == STATE_FADEIN)
         run_fadein (data);
+    else if (conv_pending)
+        convert_all ();
 
     if (state == STATE_RUNNING || state == STATE_FINISHED || state == STATE_FLUSHED)
     {
-        buffer.insert (data.begin (), -1, data.len ());
+        buffer_append (data.begin (), data.len ());
         output_data_as_ready (buffer_needed_for_state (), state != STATE_RUNNING);
     }
 
     if (state == STATE_FADEIN || state == STATE_RUNNING)
     {
+        /* the song ended before the fade-in was complete */
+        if (state == STATE_FADEIN)
+            settle_fadeout ();
+
         if (aud_get_bool ("crossfade", "automatic"))
         {
             state = STATE_FINISHED;
@@ -295,18 +796,19 @@ Index<float> & Crossfade::finish (Index<float> & data, bool end_of_playlist)
         }
     }
 
+    finish_song ();
+
     if (end_of_playlist && (state == STATE_FINISHED || state == STATE_FLUSHED))
     {
-        do_ramp (buffer.begin (), buffer.len (), 1.0, 0.0);
-
         state = STATE_OFF;
-        output_data_as_ready (0, true);
+        output_faded_out ();
     }
 
+    update_latency ();
     return output;
 }
 
 int Crossfade::adjust_delay (int delay)
 {
-    return delay + aud::rescale<int64_t> (buffer.len () / current_channels, current_rate, 1000);
+    return latency.adjust_delay (delay);
 }
@@ -0,0 +1 @@
+#include "../effect-common/song-info.cc"
@@ -23,14 +23,30 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/effect-params.h"
+#include "../effect-common/fused-effects.h"
+
 static const char * const cryst_defaults[] = {
  "intensity", "1",
  nullptr};
 
+enum {
+    CRYST_INTENSITY
+};
+
+static const EffectParam cryst_param_list[] = {
+    {"intensity", EffectParam::Float}
+};
+
+static EffectParams cryst_params ("crystalizer", cryst_param_list);
+
+static void cryst_changed ()
+    { effect_settings_changed ("crystalizer"); }
+
 static const PreferencesWidget cryst_widgets[] = {
     WidgetLabel (N_("<b>Crystalizer</b>")),
     WidgetSpin (N_("Intensity:"),
-        WidgetFloat ("crystalizer", "intensity"),
+        WidgetFloat ("crystalizer", "intensity", cryst_changed),
         {0, 10, 0.1})
 };
 
@@ -61,14 +77,21 @@ EXPORT Crystalizer aud_plugin_instance;
 static int cryst_channels;
 static Index<float> cryst_prev;
 
+static void cryst_process (float * data, int frames);
+static FusedStage cryst_stage (aud_plugin_instance, cryst_process);
+
 bool Crystalizer::init ()
 {
     aud_config_set_defaults ("crystalizer", cryst_defaults);
+    cryst_params.init ();
+    fused_register (cryst_stage);
     return true;
 }
 
 void Crystalizer::cleanup ()
 {
+    fused_unregister (cryst_stage);
+    cryst_params.cleanup ();
     cryst_prev.clear ();
 }
 
@@ -77,13 +100,15 @@ void Crystalizer::start (int & channels, int & rate)
     cryst_channels = channels;
     cryst_prev.resize (cryst_channels);
     cryst_prev.erase (0, cryst_channels);
+
+    fused_start (cryst_stage, channels, rate);
 }
 
-Index<float> & Crystalizer::process (Index<float> & data)
+static void cryst_process (float * data, int frames)
 {
-    float value = aud_get_double ("crystalizer", "intensity");
-    float * f = data.begin ();
-    float * end = data.end ();
+    float value = cryst_params.get (CRYST_INTENSITY);
+    float * f = data;
+    float * end = data + frames * cryst_channels;
 
     while (f < end)
     {
@@ -94,7 +119,11 @@ Index<float> & Crystalizer::process (Index<float> & data)
             cryst_prev[channel] = current;
         }
     }
+}
 
+Index<float> & Crystalizer::process (Index<float> & data)
+{
+    fused_process (cryst_stage, data);
     return data;
 }
 
@@ -0,0 +1 @@
+#include "../effect-common/fused-effects.cc"
@@ -1,9 +1,21 @@
+#include <string.h>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/effect-params.h"
+#include "../effect-common/fused-effects.h"
+
 #define MAX_DELAY 1000
+#define MAX_TAPS 8
+
+enum {
+    MODE_ECHO,
+    MODE_PINGPONG,
+    MODE_MULTITAP
+};
 
 static const char echo_about[] =
  N_("Echo Plugin\n"
@@ -15,19 +27,54 @@ static const char * const echo_defaults[] = {
  "delay", "500",
  "feedback", "50",
  "volume", "50",
+ "mode", aud::numeric_string<MODE_ECHO>::str,
+ "taps", "4",
  nullptr};
 
+enum {
+    PARAM_DELAY,
+    PARAM_FEEDBACK,
+    PARAM_VOLUME,
+    PARAM_MODE,
+    PARAM_TAPS
+};
+
+static const EffectParam echo_param_list[] = {
+    {"delay", EffectParam::Int},
+    {"feedback", EffectParam::Int},
+    {"volume", EffectParam::Int},
+    {"mode", EffectParam::Int},
+    {"taps", EffectParam::Int}
+};
+
+static EffectParams echo_params ("echo_plugin", echo_param_list);
+
+static void echo_changed ()
+    { effect_settings_changed ("echo_plugin"); }
+
+static const ComboItem echo_modes[] = {
+    ComboItem (N_("Echo"), MODE_ECHO),
+    ComboItem (N_("Ping-pong (stereo)"), MODE_PINGPONG),
+    ComboItem (N_("Multi-tap"), MODE_MULTITAP)
+};
+
 static const PreferencesWidget echo_widgets[] = {
     WidgetLabel (N_("<b>Echo</b>")),
+    WidgetCombo (N_("Mode:"),
+        WidgetInt ("echo_plugin", "mode", echo_changed),
+        {{echo_modes}}),
     WidgetSpin (N_("Delay:"),
-        WidgetInt ("echo_plugin", "delay"),
+        WidgetInt ("echo_plugin", "delay", echo_changed),
         {0, MAX_DELAY, 10, N_("ms")}),
     WidgetSpin (N_("Feedback:"),
-        WidgetInt ("echo_plugin", "feedback"),
+        WidgetInt ("echo_plugin", "feedback", echo_changed),
         {0, 100, 1, "%"}),
     WidgetSpin (N_("Volume:"),
-        WidgetInt ("echo_plugin", "volume"),
-        {0, 100, 1, "%"})
+        WidgetInt ("echo_plugin", "volume", echo_changed),
+        {0, 100, 1, "%"}),
+    WidgetSpin (N_("Taps:"),
+        WidgetInt ("echo_plugin", "taps", echo_changed),
+        {2, MAX_TAPS, 1})
 };
 
 static const PluginPreferences echo_prefs = {{echo_widgets}};
@@ -53,23 +100,74 @@ public:
 
 EXPORT EchoPlugin aud_plugin_instance;
 
+/* The delay line is a circular buffer holding MAX_DELAY ms of interleaved
+ * samples.  Each block is processed in spans over which neither the write
+ * position nor any of the read positions wraps around, so that the inner
+ * loops are straight multiply-adds over contiguous memory.  A span is never
+ * longer than the shortest delay, so the samples being read in a span are
+ * never the ones being written in it. */
 static Index<float> buffer;
 static int w_ofs;
 
+/* settings, converted to samples and gains by the audio thread whenever they
+ * have changed */
+static int echo_serial;
+static int echo_mode;
+static int echo_taps;
+static int tap_interval[MAX_TAPS];
+static float tap_gain[MAX_TAPS];
+static float echo_feedback;
+
+static int echo_channels = 0;
+static int echo_rate = 0;
+
+static void echo_process (float * data, int frames);
+static FusedStage echo_stage (aud_plugin_instance, echo_process);
+
+static void echo_convert ()
+{
+    int delay = echo_params.get_int (PARAM_DELAY);
+    float volume = echo_params.get_int (PARAM_VOLUME) / 100.0f;
+
+    echo_mode = echo_params.get_int (PARAM_MODE);
+    echo_feedback = echo_params.get_int (PARAM_FEEDBACK) / 100.0f;
+
+    if (echo_mode == MODE_PINGPONG && echo_channels < 2)
+        echo_mode = MODE_ECHO;
+
+    /* taps are spaced evenly up to the full delay and fade out one step at
+     * a time; only the last (longest) tap is fed back */
+    echo_taps = (echo_mode == MODE_MULTITAP) ?
+     aud::clamp (echo_params.get_int (PARAM_TAPS), 2, MAX_TAPS) : 1;
+
+    for (int t = 0; t < echo_taps; t ++)
+    {
+        int ms = delay * (t + 1) / echo_taps;
+        int interval = aud::rescale (ms, 1000, echo_rate) * echo_channels;
+
+        /* sanity check; at least one frame */
+        tap_interval[t] = aud::clamp (interval, echo_channels, buffer.len ());
+        tap_gain[t] = volume * (echo_taps - t) / echo_taps;
+    }
+}
+
 bool EchoPlugin::init ()
 {
     aud_config_set_defaults ("echo_plugin", echo_defaults);
+    echo_params.init ();
+    fused_register (echo_stage);
     return true;
 }
 
 void EchoPlugin::cleanup ()
 {
+    fused_unregister (echo_stage);
+    echo_params.cleanup ();
     buffer.clear ();
+    echo_channels = 0;
+    echo_rate = 0;
 }
 
-static int echo_channels = 0;
-static int echo_rate = 0;
-
 void EchoPlugin::start (int & channels, int & rate)
 {
     if (channels != echo_channels || rate != echo_rate)
@@ -82,34 +180,186 @@ void EchoPlugin::start (int & channels, int & rate)
 
         w_ofs = 0;
     }
+
+    /* the delays depend on the rate, so convert again */
+    echo_serial = -1;
+    fused_start (echo_stage, channels, rate);
 }
 
-Index<float> & EchoPlugin::process (Index<float> & data)
+/* Four floats, mapped by the compiler onto SSE or NEON registers.  Loads and
+ * stores go through memcpy since the spans are not aligned. */
+typedef float v4f __attribute__ ((vector_size (16)));
+
+static inline v4f load4 (const float * p)
+{
+    v4f v;
+    memcpy (& v, p, sizeof v);
+    return v;
+}
+
+static inline void store4 (float * p, v4f v)
+{
+    memcpy (p, & v, sizeof v);
+}
+
+static inline v4f splat4 (float f)
+{
+    v4f v = {f, f, f, f};
+    return v;
+}
+
+static void echo_span (float * data, const float * r, float * w, int len)
 {
-    int delay = aud_get_int ("echo_plugin", "delay");
-    float feedback = aud_get_int ("echo_plugin", "feedback") / 100.0f;
-    float volume = aud_get_int ("echo_plugin", "volume") / 100.0f;
+    v4f volume = splat4 (tap_gain[0]), feedback = splat4 (echo_feedback);
+    int i = 0;
 
-    int interval = aud::rescale (delay, 1000, echo_rate) * echo_channels;
-    interval = aud::clamp (interval, 0, buffer.len ());  // sanity check
+    for (; i + 4 <= len; i += 4)
+    {
+        v4f in = load4 (data + i), buf = load4 (r + i);
+        store4 (data + i, in + buf * volume);
+        store4 (w + i, in + buf * feedback);
+    }
+
+    for (; i < len; i ++)
+    {
+        float in = data[i], buf = r[i];
+        data[i] = in + buf * tap_gain[0];
+        w[i] = in + buf * echo_feedback;
+    }
+}
+
+/* The first two channels feed back into each other, so that successive
+ * echoes alternate between left and right. */
+static void pingpong_span (float * data, const float * r, float * w, int len)
+{
+    if (echo_channels == 2)
+    {
+        v4f volume = splat4 (tap_gain[0]), feedback = splat4 (echo_feedback);
+        int i = 0;
+
+        for (; i + 4 <= len; i += 4)
+        {
+            v4f in = load4 (data + i), buf = load4 (r + i);
+            v4f cross = {buf[1], buf[0], buf[3], buf[2]};
+            store4 (data + i, in + buf * volume);
+            store4 (w + i, in + cross * feedback);
+        }
+
+        for (; i < len; i += 2)
+        {
+            float left = r[i], right = r[i + 1];
+            w[i] = data[i] + right * echo_feedback;
+            w[i + 1] = data[i + 1] + left * echo_feedback;
+            data[i] += left * tap_gain[0];
+            data[i + 1] += right * tap_gain[0];
+        }
 
-    int r_ofs = w_ofs - interval;
-    if (r_ofs < 0)
-        r_ofs += buffer.len ();
+        return;
+    }
+
+    for (int i = 0; i < len; i += echo_channels)
+    {
+        float left = r[i], right = r[i + 1];
+        w[i] = data[i] + right * echo_feedback;
+        w[i + 1] = data[i + 1] + left * echo_feedback;
+        data[i] += left * tap_gain[0];
+        data[i + 1] += right * tap_gain[0];
 
-    float * end = data.end ();
+        for (int c = 2; c < echo_channels; c ++)
+        {
+            float in = data[i + c], buf = r[i + c];
+            data[i + c] = in + buf * tap_gain[0];
+            w[i + c] = in + buf * echo_feedback;
+        }
+    }
+}
 
-    for (float * f = data.begin (); f < end; f++)
+static void multitap_span (float * data, const float * const * r, float * w,
+ int len, int taps)
+{
+    const float * last = r[taps - 1];
+    v4f feedback = splat4 (echo_feedback);
+    int i = 0;
+
+    for (; i + 4 <= len; i += 4)
     {
-        float in = * f;
-        float buf = buffer[r_ofs];
+        v4f in = load4 (data + i), out = in;
 
-        * f = in + buf * volume;
-        buffer[w_ofs] = in + buf * feedback;
+        for (int t = 0; t < taps; t ++)
+            out += load4 (r[t] + i) * splat4 (tap_gain[t]);
 
-        r_ofs = (r_ofs + 1) % buffer.len ();
-        w_ofs = (w_ofs + 1) % buffer.len ();
+        store4 (data + i, out);
+        store4 (w + i, in + load4 (last + i) * feedback);
     }
 
+    for (; i < len; i ++)
+    {
+        float in = data[i], out = in;
+
+        for (int t = 0; t < taps; t ++)
+            out += r[t][i] * tap_gain[t];
+
+        data[i] = out;
+        w[i] = in + last[i] * echo_feedback;
+    }
+}
+
+static void echo_process (float * data, int frames)
+{
+    if (echo_params.changed (echo_serial))
+        echo_convert ();
+
+    int mode = echo_mode, taps = echo_taps;
+    int size = buffer.len ();
+    int r_ofs[MAX_TAPS];
+    const float * r[MAX_TAPS];
+
+    for (int t = 0; t < taps; t ++)
+    {
+        r_ofs[t] = w_ofs - tap_interval[t];
+        if (r_ofs[t] < 0)
+            r_ofs[t] += size;
+    }
+
+    float * f = data;
+    int remain = frames * echo_channels;
+
+    while (remain > 0)
+    {
+        int len = aud::min (remain, size - w_ofs);
+        len = aud::min (len, tap_interval[0]);
+
+        for (int t = 0; t < taps; t ++)
+        {
+            len = aud::min (len, size - r_ofs[t]);
+            r[t] = & buffer[r_ofs[t]];
+        }
+
+        float * w = & buffer[w_ofs];
+
+        if (mode == MODE_MULTITAP)
+            multitap_span (f, r, w, len, taps);
+        else if (mode == MODE_PINGPONG)
+            pingpong_span (f, r[0], w, len);
+        else
+            echo_span (f, r[0], w, len);
+
+        f += len;
+        remain -= len;
+
+        if ((w_ofs += len) == size)
+            w_ofs = 0;
+
+        for (int t = 0; t < taps; t ++)
+        {
+            if ((r_ofs[t] += len) == size)
+                r_ofs[t] = 0;
+        }
+    }
+}
+
+Index<float> & EchoPlugin::process (Index<float> & data)
+{
+    fused_process (echo_stage, data);
     return data;
 }
@@ -0,0 +1 @@
+#include "../effect-common/effect-chain.cc"
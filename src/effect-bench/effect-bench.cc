@@ -0,0 +1,631 @@
+/*
+ * Offline benchmark for effect plugins
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+/* Loads a single effect plugin, outside of Audacious, and pushes audio
+ * through it as fast as it will go, either generated or read from a file of
+ * raw PCM.  Reports the time taken per input sample, the number of heap
+ * allocations made per block and the latency reported by adjust_delay().
+ *
+ * Only process() is timed and counted, after a few blocks of warm-up, since
+ * buffers normally grow to their working size during the first blocks.
+ * finish() is timed separately. */
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+
+#include <gmodule.h>
+
+#include <libaudcore/audio.h>
+#include <libaudcore/audstrings.h>
+#include <libaudcore/hook.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/plugins.h>
+#include <libaudcore/runtime.h>
+
+#include "../effect-common/effect-params.h"
+
+/* Heap allocations are counted by wrapping malloc() and friends, which must
+ * be exported so that they take the place of those in the C library for the
+ * plugin as well.  operator new is implemented on top of malloc(), and Index
+ * uses realloc(). */
+static std::atomic<bool> counting (false);
+static std::atomic<long> allocations (0);
+
+#ifdef __GLIBC__
+
+#define HAVE_ALLOCATION_COUNT
+
+extern "C" {
+
+void * __libc_malloc (size_t size);
+void * __libc_calloc (size_t n, size_t size);
+void * __libc_realloc (void * ptr, size_t size);
+
+EXPORT void * malloc (size_t size) __THROW
+{
+    if (counting.load (std::memory_order_relaxed))
+        allocations.fetch_add (1, std::memory_order_relaxed);
+
+    return __libc_malloc (size);
+}
+
+EXPORT void * calloc (size_t n, size_t size) __THROW
+{
+    if (counting.load (std::memory_order_relaxed))
+        allocations.fetch_add (1, std::memory_order_relaxed);
+
+    return __libc_calloc (n, size);
+}
+
+EXPORT void * realloc (void * ptr, size_t size) __THROW
+{
+    if (counting.load (std::memory_order_relaxed) && size)
+        allocations.fetch_add (1, std::memory_order_relaxed);
+
+    return __libc_realloc (ptr, size);
+}
+
+} // extern "C"
+
+#endif // __GLIBC__
+
+enum {
+    SIGNAL_SINE,
+    SIGNAL_NOISE,
+    SIGNAL_BURSTS,
+    SIGNAL_SILENCE
+};
+
+static const char * const signal_names[] = {
+    "sine",
+    "noise",
+    "bursts",
+    "silence"
+};
+
+static const struct {
+    const char * name;
+    int format;
+    int bytes;
+} file_formats[] = {
+    {"float", FMT_FLOAT, 4},
+    {"s16", FMT_S16_NE, 2},
+    {"s24", FMT_S24_NE, 4},
+    {"s32", FMT_S32_NE, 4}
+};
+
+struct Options
+{
+    int rate = 44100;
+    int channels = 2;
+    int block = 1024;
+    double seconds = 10;
+    int warmup = 16;
+    int signal = SIGNAL_SINE;
+    const char * file = nullptr;
+    int format = 0;  /* index into file_formats */
+    bool machine = false;
+};
+
+static void usage (FILE * out)
+{
+    fprintf (out,
+     "Usage: effect-bench [OPTION]... PLUGIN\n"
+     "Benchmark an Audacious effect plugin.  PLUGIN is the path of the module,\n"
+     "or its name (e.g. \"compressor\") to load it from the installed plugins.\n"
+     "\n"
+     "  -r, --rate=HZ           input sample rate (default 44100)\n"
+     "  -c, --channels=N        input channels (default 2)\n"
+     "  -b, --block=FRAMES      frames per block (default 1024)\n"
+     "  -t, --seconds=SECS      length of the input (default 10; 0 for the\n"
+     "                          whole file)\n"
+     "  -w, --warmup=BLOCKS     blocks to run before measuring (default 16)\n"
+     "  -s, --signal=TYPE       sine, noise, bursts or silence (default sine)\n"
+     "  -i, --input=FILE        read raw interleaved PCM from FILE instead\n"
+     "  -f, --format=FMT        format of FILE: float, s16, s24 or s32, in\n"
+     "                          native byte order (default float)\n"
+     "  -o, --set=SECT:KEY=VAL  change a setting after the plugin is loaded\n"
+     "  -m, --machine           print the results as a single line of\n"
+     "                          key=value pairs\n"
+     "  -h, --help              show this help\n");
+}
+
+static int lookup (const char * name, const char * const * names, int count)
+{
+    for (int i = 0; i < count; i ++)
+    {
+        if (! strcmp (name, names[i]))
+            return i;
+    }
+
+    return -1;
+}
+
+/* applies a setting given as section:key=value */
+static bool apply_setting (const char * arg)
+{
+    const char * colon = strchr (arg, ':');
+    const char * equals = colon ? strchr (colon, '=') : nullptr;
+
+    if (! colon || ! equals || colon == arg || equals == colon + 1)
+        return false;
+
+    String section (str_copy (arg, colon - arg));
+    String key (str_copy (colon + 1, equals - (colon + 1)));
+
+    aud_set_str (section, key, equals + 1);
+
+    /* let the plugin refresh any snapshot of its settings */
+    hook_call (EFFECT_PARAMS_HOOK, (void *) (const char *) section);
+    return true;
+}
+
+static EffectPlugin * load_effect (const char * name, GModule * & module)
+{
+    StringBuf path = strchr (name, G_DIR_SEPARATOR) ? str_copy (name) :
+     str_concat ({INSTALL_PLUGINDIR, G_DIR_SEPARATOR_S "Effect" G_DIR_SEPARATOR_S,
+     name, PLUGIN_SUFFIX});
+
+    module = g_module_open (path, G_MODULE_BIND_LOCAL);
+    if (! module)
+    {
+        fprintf (stderr, "Failed to open %s: %s\n", (const char *) path, g_module_error ());
+        return nullptr;
+    }
+
+    Plugin * header;
+    if (! g_module_symbol (module, "aud_plugin_instance", (void * *) & header) ||
+     header->magic != _AUD_PLUGIN_MAGIC)
+    {
+        fprintf (stderr, "Not a valid Audacious plugin: %s\n", (const char *) path);
+        return nullptr;
+    }
+
+    if (header->version < _AUD_PLUGIN_VERSION_MIN || header->version > _AUD_PLUGIN_VERSION)
+    {
+        fprintf (stderr, "Plugin %s was built for a different version of Audacious.\n",
+         (const char *) path);
+        return nullptr;
+    }
+
+    if (header->type != PluginType::Effect)
+    {
+        fprintf (stderr, "Not an effect plugin: %s\n", (const char *) path);
+        return nullptr;
+    }
+
+    return (EffectPlugin *) header;
+}
+
+class Source
+{
+public:
+    Source (const Options & opts) :
+        m_opts (opts),
+        m_total ((int64_t) (opts.seconds * opts.rate)) {}
+
+    ~Source ()
+    {
+        if (m_file)
+            fclose (m_file);
+    }
+
+    bool open ();
+
+    /* fills <data> with the next block; returns false at the end */
+    bool read (Index<float> & data);
+
+private:
+    bool read_file (Index<float> & data, int frames);
+    void generate (float * f, int frames);
+
+    const Options & m_opts;
+    const int64_t m_total;  /* in frames; 0 for no limit */
+
+    FILE * m_file = nullptr;
+    Index<char> m_raw;
+
+    int64_t m_pos = 0;
+    uint32_t m_seed = 1;
+};
+
+bool Source::open ()
+{
+    if (! m_opts.file)
+        return true;
+
+    m_file = fopen (m_opts.file, "rb");
+    if (! m_file)
+    {
+        fprintf (stderr, "Failed to open %s: %s\n", m_opts.file, strerror (errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool Source::read (Index<float> & data)
+{
+    int frames = m_opts.block;
+    if (m_total)
+        frames = aud::min ((int64_t) frames, m_total - m_pos);
+
+    if (m_file)
+    {
+        if (frames <= 0 || ! read_file (data, frames))
+            return false;
+    }
+    else
+    {
+        if (frames <= 0)
+            return false;
+
+        data.resize (frames * m_opts.channels);
+        generate (data.begin (), frames);
+    }
+
+    m_pos += data.len () / m_opts.channels;
+    return true;
+}
+
+bool Source::read_file (Index<float> & data, int frames)
+{
+    int bytes = file_formats[m_opts.format].bytes;
+    int samples = frames * m_opts.channels;
+
+    m_raw.resize (samples * bytes);
+    int got = fread (m_raw.begin (), bytes * m_opts.channels, frames, m_file);
+    if (got <= 0)
+        return false;
+
+    samples = got * m_opts.channels;
+    data.resize (samples);
+
+    if (file_formats[m_opts.format].format == FMT_FLOAT)
+        memcpy (data.begin (), m_raw.begin (), sizeof (float) * samples);
+    else
+        audio_from_int (m_raw.begin (), file_formats[m_opts.format].format,
+         data.begin (), samples);
+
+    return true;
+}
+
+void Source::generate (float * f, int frames)
+{
+    int channels = m_opts.channels;
+
+    for (int i = 0; i < frames; i ++)
+    {
+        int64_t pos = m_pos + i;
+        double t = (double) pos / m_opts.rate;
+
+        for (int c = 0; c < channels; c ++)
+        {
+            float value = 0;
+
+            switch (m_opts.signal)
+            {
+            case SIGNAL_SINE:
+                /* a slightly different tone in each channel */
+                value = 0.5f * sinf (2 * M_PI * (440 + 110 * c) * t);
+                break;
+
+            case SIGNAL_NOISE:
+                m_seed = m_seed * 1664525 + 1013904223;
+                value = 0.5f * ((int32_t) m_seed / 2147483648.0f);
+                break;
+
+            case SIGNAL_BURSTS:
+                /* one second of tone, then one of near silence */
+                value = (pos / m_opts.rate % 2) ? 0.0001f :
+                 0.8f * sinf (2 * M_PI * (440 + 110 * c) * t);
+                break;
+            }
+
+            * f ++ = value;
+        }
+    }
+}
+
+struct Results
+{
+    int64_t blocks = 0;
+    int64_t samples = 0;
+    double ns = 0, worst_ns = 0;
+    long allocations = 0;
+
+    int64_t out_frames = 0;
+    int out_channels = 0, out_rate = 0;
+
+    int latency_min = 0, latency_max = 0;
+    double latency_sum = 0;
+    int64_t latency_count = 0;
+
+    double finish_ns = 0;
+};
+
+static double now_ns ()
+{
+    auto now = std::chrono::steady_clock::now ().time_since_epoch ();
+    return std::chrono::duration<double, std::nano> (now).count ();
+}
+
+static void add_latency (Results & res, int delay)
+{
+    if (! res.latency_count || delay < res.latency_min)
+        res.latency_min = delay;
+    if (! res.latency_count || delay > res.latency_max)
+        res.latency_max = delay;
+
+    res.latency_sum += delay;
+    res.latency_count ++;
+}
+
+static bool run (EffectPlugin * effect, const Options & opts, Results & res)
+{
+    Source source (opts);
+    if (! source.open ())
+        return false;
+
+    int channels = opts.channels, rate = opts.rate;
+    effect->start (channels, rate);
+
+    res.out_channels = channels;
+    res.out_rate = rate;
+
+    Index<float> data;
+    int64_t block = 0;
+
+    while (source.read (data))
+    {
+        int samples = data.len ();
+        bool measure = (block ++ >= opts.warmup);
+
+        counting.store (measure);
+        double start = now_ns ();
+
+        Index<float> & out = effect->process (data);
+
+        double time = now_ns () - start;
+        counting.store (false);
+
+        res.out_frames += out.len () / channels;
+
+        if (measure)
+        {
+            res.blocks ++;
+            res.samples += samples;
+            res.ns += time;
+            res.worst_ns = aud::max (res.worst_ns, time);
+
+            add_latency (res, effect->adjust_delay (0));
+        }
+    }
+
+    if (! res.blocks)
+    {
+        fprintf (stderr, "Input is too short; nothing was measured past the warm-up.\n");
+        return false;
+    }
+
+    res.allocations = allocations.load ();
+
+    data.resize (0);
+
+    double start = now_ns ();
+    Index<float> & out = effect->finish (data, true);
+    res.finish_ns = now_ns () - start;
+
+    res.out_frames += out.len () / channels;
+
+    effect->flush (true);
+    return true;
+}
+
+static void print_results (const char * name, const char * arg,
+ const Options & opts, const Results & res)
+{
+    double ns_per_sample = res.ns / res.samples;
+    double allocs_per_block = (double) res.allocations / res.blocks;
+    double latency_mean = res.latency_sum / res.latency_count;
+
+#ifndef HAVE_ALLOCATION_COUNT
+    allocs_per_block = -1;
+#endif
+
+    if (opts.machine)
+    {
+        const char * slash = strrchr (arg, G_DIR_SEPARATOR);
+
+        printf ("plugin=%s rate=%d channels=%d block=%d signal=%s "
+         "ns_per_sample=%.3f worst_block_us=%.3f allocs_per_block=%.3f "
+         "latency_min_ms=%d latency_mean_ms=%.3f latency_max_ms=%d "
+         "finish_us=%.3f out_rate=%d out_channels=%d out_frames=%lld\n",
+         slash ? slash + 1 : arg, opts.rate, opts.channels, opts.block,
+         opts.file ? "file" : signal_names[opts.signal], ns_per_sample,
+         res.worst_ns / 1000, allocs_per_block, res.latency_min, latency_mean,
+         res.latency_max, res.finish_ns / 1000, res.out_rate, res.out_channels,
+         (long long) res.out_frames);
+        return;
+    }
+
+    printf ("Plugin:      %s\n", name);
+    printf ("Input:       %d Hz, %d channels, %d-frame blocks, %s\n", opts.rate,
+     opts.channels, opts.block, opts.file ? opts.file : signal_names[opts.signal]);
+    printf ("Output:      %d Hz, %d channels, %lld frames\n", res.out_rate,
+     res.out_channels, (long long) res.out_frames);
+    printf ("Measured:    %lld blocks after %d of warm-up\n", (long long) res.blocks, opts.warmup);
+    printf ("Process:     %.3f ns/sample, worst block %.1f us\n", ns_per_sample, res.worst_ns / 1000);
+    printf ("Finish:      %.1f us\n", res.finish_ns / 1000);
+
+    if (allocs_per_block >= 0)
+        printf ("Allocations: %.3f per block (%ld in all)\n", allocs_per_block, res.allocations);
+    else
+        printf ("Allocations: not counted on this platform\n");
+
+    printf ("Latency:     %d ms min, %.1f ms mean, %d ms max\n", res.latency_min,
+     latency_mean, res.latency_max);
+}
+
+int main (int argc, char * * argv)
+{
+    static const struct option long_opts[] = {
+        {"rate", required_argument, nullptr, 'r'},
+        {"channels", required_argument, nullptr, 'c'},
+        {"block", required_argument, nullptr, 'b'},
+        {"seconds", required_argument, nullptr, 't'},
+        {"warmup", required_argument, nullptr, 'w'},
+        {"signal", required_argument, nullptr, 's'},
+        {"input", required_argument, nullptr, 'i'},
+        {"format", required_argument, nullptr, 'f'},
+        {"set", required_argument, nullptr, 'o'},
+        {"machine", no_argument, nullptr, 'm'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    Options opts;
+    Index<const char *> settings;
+    bool seconds_given = false;
+    int c;
+
+    while ((c = getopt_long (argc, argv, "r:c:b:t:w:s:i:f:o:mh", long_opts, nullptr)) != -1)
+    {
+        switch (c)
+        {
+        case 'r':
+            opts.rate = atoi (optarg);
+            break;
+        case 'c':
+            opts.channels = atoi (optarg);
+            break;
+        case 'b':
+            opts.block = atoi (optarg);
+            break;
+        case 't':
+            opts.seconds = atof (optarg);
+            seconds_given = true;
+            break;
+        case 'w':
+            opts.warmup = atoi (optarg);
+            break;
+        case 's':
+            opts.signal = lookup (optarg, signal_names, aud::n_elems (signal_names));
+            if (opts.signal < 0)
+            {
+                fprintf (stderr, "Unknown signal: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'i':
+            opts.file = optarg;
+            break;
+        case 'f':
+            opts.format = -1;
+            for (int i = 0; i < aud::n_elems (file_formats); i ++)
+            {
+                if (! strcmp (optarg, file_formats[i].name))
+                    opts.format = i;
+            }
+            if (opts.format < 0)
+            {
+                fprintf (stderr, "Unknown format: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'o':
+            settings.append (optarg);
+            break;
+        case 'm':
+            opts.machine = true;
+            break;
+        case 'h':
+            usage (stdout);
+            return EXIT_SUCCESS;
+        default:
+            usage (stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        usage (stderr);
+        return EXIT_FAILURE;
+    }
+
+    if (opts.rate < 1 || opts.channels < 1 || opts.channels > AUD_MAX_CHANNELS ||
+     opts.block < 1 || opts.seconds < 0 || opts.warmup < 0)
+    {
+        fprintf (stderr, "Invalid rate, channel count, block size, length or warm-up.\n");
+        return EXIT_FAILURE;
+    }
+
+    /* a file is read to the end unless told otherwise */
+    if (opts.file && ! seconds_given)
+        opts.seconds = 0;
+    else if (! opts.file && opts.seconds == 0)
+    {
+        fprintf (stderr, "A generated signal needs a length.\n");
+        return EXIT_FAILURE;
+    }
+
+    aud_init_paths ();
+
+    GModule * module = nullptr;
+    EffectPlugin * effect = load_effect (argv[optind], module);
+    bool success = false;
+
+    if (effect && effect->init ())
+    {
+        success = true;
+
+        for (const char * setting : settings)
+        {
+            if (! apply_setting (setting))
+            {
+                fprintf (stderr, "Invalid setting (expected SECTION:KEY=VALUE): %s\n", setting);
+                success = false;
+            }
+        }
+
+        Results res;
+        if (success && (success = run (effect, opts, res)))
+            print_results (effect->info.name, argv[optind], opts, res);
+
+        effect->cleanup ();
+    }
+    else if (effect)
+        fprintf (stderr, "Plugin failed to initialize: %s\n", argv[optind]);
+
+    if (module)
+        g_module_close (module);
+
+    aud_cleanup_paths ();
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
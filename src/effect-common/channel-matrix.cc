@@ -0,0 +1,246 @@
+/*
+ * channel-matrix.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "channel-matrix.h"
+
+#include <string.h>
+
+#include <libaudcore/objects.h>
+
+#define MINUS_3DB 0.70710678f
+
+enum Speaker
+{
+    FL, FR, FC, LFE, BL, BR, BC, SL, SR,
+    N_SPEAKERS
+};
+
+static const int max_layout = 8;
+
+/* WAVE/SMPTE channel order for 1 through 8 channels */
+static const Speaker layouts[max_layout][max_layout] = {
+    {FC},
+    {FL, FR},
+    {FL, FR, FC},
+    {FL, FR, BL, BR},
+    {FL, FR, FC, BL, BR},
+    {FL, FR, FC, LFE, BL, BR},
+    {FL, FR, FC, LFE, BC, SL, SR},
+    {FL, FR, FC, LFE, BL, BR, SL, SR}
+};
+
+/* Where a speaker goes when the output layout lacks it, in order of preference.
+ * Each entry is a list of up to two (speaker, gain) pairs; the first entry
+ * whose speakers are all present in the output layout is used. */
+struct Fold
+{
+    Speaker to[2];
+    float gain;
+};
+
+static const Fold folds[N_SPEAKERS][3] = {
+    /* FL */ {{{FC, FC}, 0.5f}},
+    /* FR */ {{{FC, FC}, 0.5f}},
+    /* FC */ {{{FL, FR}, MINUS_3DB}},
+    /* LFE */ {},
+    /* BL */ {{{SL, SL}, 1}, {{FL, FL}, MINUS_3DB}, {{FC, FC}, 0.5f * MINUS_3DB}},
+    /* BR */ {{{SR, SR}, 1}, {{FR, FR}, MINUS_3DB}, {{FC, FC}, 0.5f * MINUS_3DB}},
+    /* BC */ {{{BL, BR}, MINUS_3DB}, {{SL, SR}, MINUS_3DB}, {{FL, FR}, 0.5f}},
+    /* SL */ {{{BL, BL}, 1}, {{FL, FL}, MINUS_3DB}, {{FC, FC}, 0.5f * MINUS_3DB}},
+    /* SR */ {{{BR, BR}, 1}, {{FR, FR}, MINUS_3DB}, {{FC, FC}, 0.5f * MINUS_3DB}}
+};
+
+static int find_speaker (const Speaker * layout, int channels, Speaker speaker)
+{
+    for (int c = 0; c < channels; c ++)
+    {
+        if (layout[c] == speaker)
+            return c;
+    }
+
+    return -1;
+}
+
+Index<float> channel_matrix (int in_channels, int out_channels)
+{
+    Index<float> matrix;
+    matrix.insert (0, in_channels * out_channels);
+
+    /* unknown layouts: connect channels one-to-one and drop the rest */
+    if (in_channels > max_layout || out_channels > max_layout)
+    {
+        for (int c = 0; c < aud::min (in_channels, out_channels); c ++)
+            matrix[c * in_channels + c] = 1;
+
+        return matrix;
+    }
+
+    const Speaker * in_layout = layouts[in_channels - 1];
+    const Speaker * out_layout = layouts[out_channels - 1];
+
+    for (int i = 0; i < in_channels; i ++)
+    {
+        Speaker speaker = in_layout[i];
+        int o = find_speaker (out_layout, out_channels, speaker);
+
+        if (o >= 0)
+        {
+            matrix[o * in_channels + i] = 1;
+            continue;
+        }
+
+        /* a mono source plays at full volume on both front speakers */
+        if (in_channels == 1 && speaker == FC)
+        {
+            matrix[0 * in_channels + i] = 1;
+            matrix[1 * in_channels + i] = 1;
+            continue;
+        }
+
+        for (const Fold & fold : folds[speaker])
+        {
+            if (! fold.gain)
+                break;
+
+            int o1 = find_speaker (out_layout, out_channels, fold.to[0]);
+            int o2 = find_speaker (out_layout, out_channels, fold.to[1]);
+
+            if (o1 < 0 || o2 < 0)
+                continue;
+
+            matrix[o1 * in_channels + i] += fold.gain;
+            if (o2 != o1)
+                matrix[o2 * in_channels + i] += fold.gain;
+
+            break;
+        }
+    }
+
+    /* scale downmixes so that no output channel can exceed full scale */
+    if (out_channels < in_channels)
+    {
+        float max_sum = 0;
+
+        for (int o = 0; o < out_channels; o ++)
+        {
+            float sum = 0;
+            for (int i = 0; i < in_channels; i ++)
+                sum += matrix[o * in_channels + i];
+
+            max_sum = aud::max (max_sum, sum);
+        }
+
+        if (max_sum > 1)
+        {
+            for (float & gain : matrix)
+                gain /= max_sum;
+        }
+    }
+
+    return matrix;
+}
+
+void channel_matrix_apply (const float * matrix, int in_channels,
+ int out_channels, const float * in, float * out, int frames)
+{
+    while (frames --)
+    {
+        const float * row = matrix;
+
+        for (int o = 0; o < out_channels; o ++)
+        {
+            float sum = 0;
+            for (int i = 0; i < in_channels; i ++)
+                sum += row[i] * in[i];
+
+            * out ++ = sum;
+            row += in_channels;
+        }
+
+        in += in_channels;
+    }
+}
+
+/* Four floats, mapped by the compiler onto SSE or NEON registers. */
+typedef float v4f __attribute__ ((vector_size (16)));
+
+/* With the channel counts fixed at compile time, the loops below unroll
+ * completely: column <i> of the matrix occupies <V> vectors (one per four
+ * output channels, zero-padded), and each input sample is broadcast and
+ * multiplied into them. */
+template<int IN, int OUT>
+static void apply_fixed (const float * matrix, const float * in, float * out,
+ int frames)
+{
+    constexpr int V = (OUT + 3) / 4;
+
+    v4f cols[IN][V];
+
+    for (int i = 0; i < IN; i ++)
+    {
+        for (int v = 0; v < V; v ++)
+        {
+            for (int k = 0; k < 4; k ++)
+            {
+                int o = v * 4 + k;
+                cols[i][v][k] = (o < OUT) ? matrix[o * IN + i] : 0;
+            }
+        }
+    }
+
+    while (frames --)
+    {
+        v4f acc[V];
+
+        for (int v = 0; v < V; v ++)
+            acc[v] = v4f ();
+
+        for (int i = 0; i < IN; i ++)
+        {
+            v4f x = {in[i], in[i], in[i], in[i]};
+
+            for (int v = 0; v < V; v ++)
+                acc[v] += cols[i][v] * x;
+        }
+
+        memcpy (out, acc, OUT * sizeof (float));
+
+        in += IN;
+        out += OUT;
+    }
+}
+
+#define KERNEL_ROW(in) { \
+    apply_fixed<in, 1>, apply_fixed<in, 2>, apply_fixed<in, 3>, \
+    apply_fixed<in, 4>, apply_fixed<in, 5>, apply_fixed<in, 6>, \
+    apply_fixed<in, 7>, apply_fixed<in, 8> }
+
+static const ChannelMatrixKernel kernels[max_layout][max_layout] = {
+    KERNEL_ROW (1), KERNEL_ROW (2), KERNEL_ROW (3), KERNEL_ROW (4),
+    KERNEL_ROW (5), KERNEL_ROW (6), KERNEL_ROW (7), KERNEL_ROW (8)
+};
+
+ChannelMatrixKernel channel_matrix_kernel (int in_channels, int out_channels)
+{
+    if (in_channels < 1 || in_channels > max_layout ||
+     out_channels < 1 || out_channels > max_layout)
+        return nullptr;
+
+    return kernels[in_channels - 1][out_channels - 1];
+}
@@ -0,0 +1,46 @@
+/*
+ * channel-matrix.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_CHANNEL_MATRIX_H
+#define EFFECT_COMMON_CHANNEL_MATRIX_H
+
+#include <libaudcore/index.h>
+
+// Gain matrix for converting between the standard channel layouts, mono
+// through 7.1, in WAVE channel order (FL FR FC LFE BL BR SL SR).  The matrix
+// has one row of <in_channels> gains for each output channel, so that
+// out[o] = sum (matrix[o * in_channels + i] * in[i]).  Downmixes are scaled
+// so that no output channel can exceed full scale.
+Index<float> channel_matrix (int in_channels, int out_channels);
+
+// generic (scalar) application of a matrix built as above
+void channel_matrix_apply (const float * matrix, int in_channels,
+ int out_channels, const float * in, float * out, int frames);
+
+typedef void (* ChannelMatrixKernel) (const float * matrix, const float * in,
+ float * out, int frames);
+
+// Returns a version of channel_matrix_apply() specialised for the given
+// channel counts, which keeps the matrix in SIMD registers and computes each
+// output frame as a sum of columns.  Only counts up to 8 (7.1) are covered;
+// for anything larger, nullptr is returned and the generic version should be
+// used instead.
+ChannelMatrixKernel channel_matrix_kernel (int in_channels, int out_channels);
+
+#endif // EFFECT_COMMON_CHANNEL_MATRIX_H
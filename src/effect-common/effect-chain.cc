@@ -0,0 +1,43 @@
+/*
+ * effect-chain.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "effect-chain.h"
+
+#include <algorithm>
+
+#include <libaudcore/plugin.h>
+#include <libaudcore/plugins.h>
+
+int effect_chain_get (const EffectPlugin * * chain)
+{
+    int len = 0;
+
+    for (PluginHandle * plugin : aud_plugin_list (PluginType::Effect))
+    {
+        /* enabled effects are always loaded */
+        if (len < EFFECT_CHAIN_MAX && aud_plugin_get_enabled (plugin))
+            chain[len ++] = (const EffectPlugin *) aud_plugin_get_header (plugin);
+    }
+
+    std::stable_sort (chain, chain + len,
+     [] (const EffectPlugin * a, const EffectPlugin * b)
+        { return a->order < b->order; });
+
+    return len;
+}
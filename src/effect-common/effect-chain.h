@@ -0,0 +1,35 @@
+/*
+ * effect-chain.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_EFFECT_CHAIN_H
+#define EFFECT_COMMON_EFFECT_CHAIN_H
+
+class EffectPlugin;
+
+#define EFFECT_CHAIN_MAX 64
+
+// Gets the enabled effects in the order that Audacious runs them: by order
+// value, and in the order of the plugin list (that is, by name) among those
+// with the same order value.  Fills in at most EFFECT_CHAIN_MAX effects and
+// returns their number.  This goes through the plugin registry, so it is to be
+// called from the main thread, or at most once when the chain is started,
+// never for each block.
+int effect_chain_get (const EffectPlugin * * chain);
+
+#endif // EFFECT_COMMON_EFFECT_CHAIN_H
@@ -0,0 +1,133 @@
+/*
+ * effect-latency.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "effect-latency.h"
+
+#include <math.h>
+
+#include <chrono>
+
+#include <libaudcore/hook.h>
+#include <libaudcore/runtime.h>
+
+#include "effect-chain.h"
+
+#define LOG_INTERVAL 1000 /* milliseconds */
+
+void EffectLatency::init ()
+{
+    m_frames.store (0);
+    m_rate.store (0);
+    m_scale.store (1);
+    m_logged_at = 0;
+
+    hook_associate (EFFECT_LATENCY_HOOK, query_cb, this);
+}
+
+void EffectLatency::cleanup ()
+{
+    hook_dissociate (EFFECT_LATENCY_HOOK, query_cb, this);
+}
+
+void EffectLatency::set (int frames, int rate, float scale)
+{
+    m_frames.store (frames, std::memory_order_relaxed);
+    m_rate.store (rate, std::memory_order_relaxed);
+    m_scale.store (scale, std::memory_order_relaxed);
+
+    log (frames, rate);
+}
+
+int EffectLatency::adjust_delay (int delay) const
+{
+    int frames = m_frames.load (std::memory_order_relaxed);
+    int rate = m_rate.load (std::memory_order_relaxed);
+    float scale = m_scale.load (std::memory_order_relaxed);
+
+    double ms = delay * (double) scale;
+    if (rate > 0)
+        ms += frames * 1000.0 / rate;
+
+    return (int) lround (ms);
+}
+
+void EffectLatency::log (int frames, int rate)
+{
+    using namespace std::chrono;
+    int64_t now = duration_cast<milliseconds> (steady_clock::now ().time_since_epoch ()).count ();
+
+    if (now - m_logged_at < LOG_INTERVAL)
+        return;
+
+    m_logged_at = now;
+
+    if (rate > 0)
+        AUDDBG ("%s latency: %d frames at %d Hz (%.3f ms)\n", m_name, frames, rate,
+         frames * 1000.0 / rate);
+}
+
+void EffectLatency::query_cb (void * list, void * me)
+{
+    auto latency = (const EffectLatency *) me;
+    auto & infos = * (Index<EffectLatencyInfo> *) list;
+
+    infos.append (EffectLatencyInfo {
+        latency->m_plugin,
+        latency->m_name,
+        latency->m_frames.load (std::memory_order_relaxed),
+        latency->m_rate.load (std::memory_order_relaxed),
+        latency->m_scale.load (std::memory_order_relaxed)
+    });
+}
+
+void effect_latency_query (Index<EffectLatencyInfo> & list)
+{
+    Index<EffectLatencyInfo> found;
+    hook_call (EFFECT_LATENCY_HOOK, & found);
+
+    const EffectPlugin * chain[EFFECT_CHAIN_MAX];
+    int len = effect_chain_get (chain);
+
+    list.resize (0);
+
+    /* effects that are loaded but not in the chain are left out */
+    for (int pos = 0; pos < len; pos ++)
+    {
+        for (const EffectLatencyInfo & info : found)
+        {
+            if (info.plugin == chain[pos])
+                list.append (info);
+        }
+    }
+}
+
+double effect_latency_total (const Index<EffectLatencyInfo> & list)
+{
+    /* each effect adds its own latency to that of the ones before it */
+    double total = 0;
+
+    for (const EffectLatencyInfo & info : list)
+    {
+        total *= info.scale;
+        if (info.rate > 0)
+            total += (double) info.frames / info.rate;
+    }
+
+    return total;
+}
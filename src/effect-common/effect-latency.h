@@ -0,0 +1,92 @@
+/*
+ * effect-latency.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_EFFECT_LATENCY_H
+#define EFFECT_COMMON_EFFECT_LATENCY_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include <libaudcore/index.h>
+
+class EffectPlugin;
+
+// Audacious asks each effect for its latency through adjust_delay(), in whole
+// milliseconds, so the rounding error grows with every effect in the chain.
+// Effects that buffer audio also keep their latency here, exactly, in frames.
+// adjust_delay() is then computed from it with a single rounding to the
+// nearest millisecond.  Since Audacious still adds up the delays of the effects
+// in whole milliseconds, anything that needs more precision than that can ask
+// for the frame counts of every effect through effect_latency_query().
+//
+// When Audacious is run with -V, the latency of each effect is also logged,
+// once a second while it is playing.
+
+#define EFFECT_LATENCY_HOOK "effect latency"
+
+struct EffectLatencyInfo
+{
+    const EffectPlugin * plugin;
+    const char * name;
+    int frames;   // audio held back by the effect, in frames at <rate>
+    int rate;
+    float scale;  // factor by which the effect stretches earlier latency
+};
+
+class EffectLatency
+{
+public:
+    constexpr EffectLatency (const EffectPlugin & plugin, const char * name) :
+        m_plugin (& plugin), m_name (name) {}
+
+    // to be called from init() and cleanup()
+    void init ();
+    void cleanup ();
+
+    // to be called whenever the amount of buffered audio changes; <scale> is
+    // the factor by which the effect stretches the latency of earlier ones
+    void set (int frames, int rate, float scale = 1);
+
+    // implements EffectPlugin::adjust_delay()
+    int adjust_delay (int delay) const;
+
+private:
+    static void query_cb (void * list, void * me);
+    void log (int frames, int rate);
+
+    const EffectPlugin * const m_plugin;
+    const char * const m_name;
+
+    std::atomic<int> m_frames {0}, m_rate {0};
+    std::atomic<float> m_scale {1};
+
+    // used only by the audio thread
+    int64_t m_logged_at = 0;
+};
+
+// Fills <list> with the latency of every loaded effect that keeps it here, in
+// the order of the effect chain.  To be called from the main thread.
+void effect_latency_query (Index<EffectLatencyInfo> & list);
+
+// Returns the total latency of the effects in <list>, in seconds, taking them
+// to be in the order of the chain.
+double effect_latency_total (const Index<EffectLatencyInfo> & list);
+
+#endif // EFFECT_COMMON_EFFECT_LATENCY_H
@@ -0,0 +1,78 @@
+/*
+ * effect-params.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "effect-params.h"
+
+#include <string.h>
+
+#include <libaudcore/hook.h>
+#include <libaudcore/runtime.h>
+
+void EffectParams::init ()
+{
+    load ();
+    hook_associate (EFFECT_PARAMS_HOOK, changed_cb, this);
+}
+
+void EffectParams::cleanup ()
+{
+    hook_dissociate (EFFECT_PARAMS_HOOK, changed_cb, this);
+}
+
+void EffectParams::load ()
+{
+    int count = aud::min (m_params.len, max_params);
+
+    for (int i = 0; i < count; i ++)
+    {
+        const EffectParam & param = m_params.data[i];
+        float value;
+
+        switch (param.type)
+        {
+        case EffectParam::Int:
+            value = aud_get_int (m_section, param.name);
+            break;
+        case EffectParam::Bool:
+            value = aud_get_bool (m_section, param.name) ? 1 : 0;
+            break;
+        default:
+            value = aud_get_double (m_section, param.name);
+            break;
+        }
+
+        m_values[i].store (value, std::memory_order_relaxed);
+    }
+
+    /* publishes the values stored above */
+    m_serial.fetch_add (1, std::memory_order_release);
+}
+
+void EffectParams::changed_cb (void * section, void * me)
+{
+    auto params = (EffectParams *) me;
+
+    if (! strcmp ((const char *) section, params->m_section))
+        params->load ();
+}
+
+void effect_settings_changed (const char * section)
+{
+    hook_call (EFFECT_PARAMS_HOOK, (void *) section);
+}
@@ -0,0 +1,98 @@
+/*
+ * effect-params.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_EFFECT_PARAMS_H
+#define EFFECT_COMMON_EFFECT_PARAMS_H
+
+#include <atomic>
+
+#include <libaudcore/objects.h>
+
+// A snapshot of the settings of an effect, so that the audio thread does not
+// have to look them up in the config (which means parsing strings under a
+// lock) on every block.  The snapshot is reloaded from the config whenever
+// the "effect settings changed" hook is called for its section, which the
+// preference widgets of the effect do through effect_settings_changed(), and
+// is read without any locking.
+//
+// Values derived from the settings (gains from levels in dB, delays in
+// frames, and so on) should be recomputed by the audio thread itself,
+// whenever changed() reports that a new snapshot has been loaded.  That way
+// they are computed only once per change, and never while being used.
+
+#define EFFECT_PARAMS_HOOK "effect settings changed"
+
+struct EffectParam
+{
+    enum Type {Int, Float, Bool};
+
+    const char * name;
+    Type type;
+};
+
+class EffectParams
+{
+public:
+    static constexpr int max_params = 32;
+
+    EffectParams (const char * section, ArrayRef<EffectParam> params) :
+        m_section (section), m_params (params) {}
+
+    // to be called from init() (after the defaults are set) and cleanup()
+    void init ();
+    void cleanup ();
+
+    // rereads every setting from the config
+    void load ();
+
+    // Returns true, once, if a new snapshot has been loaded since <serial>
+    // was last passed in.  Start <serial> at -1 so that the first call
+    // returns true.
+    bool changed (int & serial) const
+    {
+        int now = m_serial.load (std::memory_order_acquire);
+        if (now == serial)
+            return false;
+
+        serial = now;
+        return true;
+    }
+
+    float get (int param) const
+        { return m_values[param].load (std::memory_order_relaxed); }
+    int get_int (int param) const
+        { return (int) get (param); }
+    bool get_bool (int param) const
+        { return get (param) != 0; }
+
+private:
+    static void changed_cb (void * section, void * me);
+
+    const char * const m_section;
+    const ArrayRef<EffectParam> m_params;
+
+    std::atomic<float> m_values[max_params] {};
+    std::atomic<int> m_serial {0};
+};
+
+// to be called from the callbacks of preference widgets (or by anything else
+// that changes the settings of an effect)
+void effect_settings_changed (const char * section);
+
+#endif // EFFECT_COMMON_EFFECT_PARAMS_H
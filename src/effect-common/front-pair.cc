@@ -0,0 +1,60 @@
+/*
+ * front-pair.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "front-pair.h"
+
+#include <libaudcore/objects.h>
+
+/* frames per tile; 2 KB of floats */
+#define TILE_FRAMES 256
+
+void front_pair_process (float * data, int channels, int frames, StereoFunc func)
+{
+    if (channels == 2)
+    {
+        func (data, frames);
+        return;
+    }
+
+    float pair[2 * TILE_FRAMES];
+
+    while (frames > 0)
+    {
+        int tile = aud::min (frames, TILE_FRAMES);
+
+        const float * in = data;
+        for (int i = 0; i < tile; i ++, in += channels)
+        {
+            pair[2 * i] = in[0];
+            pair[2 * i + 1] = in[1];
+        }
+
+        func (pair, tile);
+
+        float * out = data;
+        for (int i = 0; i < tile; i ++, out += channels)
+        {
+            out[0] = pair[2 * i];
+            out[1] = pair[2 * i + 1];
+        }
+
+        data += tile * channels;
+        frames -= tile;
+    }
+}
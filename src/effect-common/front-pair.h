@@ -0,0 +1,42 @@
+/*
+ * front-pair.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_FRONT_PAIR_H
+#define EFFECT_COMMON_FRONT_PAIR_H
+
+// Extra stereo, voice removal and bs2b are defined for stereo audio only.  In
+// each of the standard layouts of more than two channels (see channel-matrix.h)
+// the first two are front left and right, so those effects can optionally be
+// applied to that pair by itself, leaving the other channels as they are.
+// This avoids having to downmix surround audio to stereo first.
+
+typedef void (* StereoFunc) (float * data, int frames);
+
+// whether <channels> begins with a front left/right pair
+static inline bool front_pair_layout (int channels)
+    { return channels >= 2 && channels <= 8; }
+
+// Runs <func>, which processes interleaved stereo audio in place, on the front
+// left and right channels of <frames> frames of audio with <channels> channels.
+// Stereo audio is passed to <func> directly.  Otherwise the pair is copied out
+// to a small buffer on the stack, a tile at a time, and copied back afterward,
+// so that nothing is allocated and the data stays in cache.
+void front_pair_process (float * data, int channels, int frames, StereoFunc func);
+
+#endif // EFFECT_COMMON_FRONT_PAIR_H
@@ -0,0 +1,184 @@
+/*
+ * fused-effects.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "fused-effects.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <libaudcore/hook.h>
+#include <libaudcore/objects.h>
+
+#include "effect-chain.h"
+
+#define STAGES_HOOK "fused effect stages"
+
+/* samples per tile; 16 KB of floats stays well within L1 cache */
+#define TILE_SAMPLES 4096
+
+#define MAX_STAGES 16
+
+/* filled in by every registered stage, in no particular order */
+struct StageList
+{
+    FusedStage * stages[MAX_STAGES];
+    int len = 0;
+};
+
+/* used only by the main thread */
+static int n_registered;
+
+static void add_stage (void * list, void * stage)
+{
+    auto & stages = * (StageList *) list;
+
+    if (stages.len < MAX_STAGES)
+        stages.stages[stages.len ++] = (FusedStage *) stage;
+}
+
+/* Links each registered stage to the stage that directly follows it in the
+ * chain, if there is one. */
+static void update_links (void * = nullptr)
+{
+    StageList list;
+    hook_call (STAGES_HOOK, & list);
+
+    const EffectPlugin * chain[EFFECT_CHAIN_MAX];
+    int len = effect_chain_get (chain);
+
+    for (int i = 0; i < list.len; i ++)
+    {
+        FusedStage * stage = list.stages[i];
+        FusedStage * next = nullptr;
+
+        int pos = 0;
+        while (pos < len && chain[pos] != stage->plugin)
+            pos ++;
+
+        /* any other effect ends the run */
+        for (int j = 0; j < list.len && pos + 1 < len; j ++)
+        {
+            if (list.stages[j]->plugin == chain[pos + 1])
+                next = list.stages[j];
+        }
+
+        stage->next.store (next);
+    }
+}
+
+void fused_register (FusedStage & stage)
+{
+    stage.next.store (nullptr);
+    stage.led.store (false);
+    stage.active.store (true);
+
+    hook_associate (STAGES_HOOK, add_stage, & stage);
+    update_links ();
+
+    if (! n_registered ++)
+        timer_add (TimerRate::Hz1, update_links);
+}
+
+void fused_unregister (FusedStage & stage)
+{
+    if (! -- n_registered)
+        timer_remove (TimerRate::Hz1, update_links);
+
+    hook_dissociate (STAGES_HOOK, add_stage, & stage);
+    update_links ();
+
+    /* A leader that has not seen the new links yet may still be about to run
+     * this stage.  Once it is marked inactive, no leader will start to; wait
+     * for any that already has, which takes at most one block. */
+    stage.active.store (false);
+    while (stage.users.load ())
+        std::this_thread::yield ();
+
+    stage.next.store (nullptr);
+    stage.led.store (false);
+}
+
+void fused_start (FusedStage & stage, int channels, int rate)
+{
+    stage.channels.store (channels);
+    stage.rate.store (rate);
+    stage.led.store (false);
+
+    update_links ();
+}
+
+void fused_process (FusedStage & stage, Index<float> & data)
+{
+    /* the stage before us has already run us over this block */
+    if (stage.led.exchange (false))
+        return;
+
+    int channels = stage.channels.load (std::memory_order_relaxed);
+    int rate = stage.rate.load (std::memory_order_relaxed);
+    int frames = data.len () / channels;
+
+    /* Collect the stages that follow us, holding each so that it cannot be
+     * cleaned up while we run it.  A stage that we cannot run ends the run
+     * there, since the stages after it must still come after it. */
+    FusedStage * run[MAX_STAGES];
+    run[0] = & stage;
+    int n_run = 1;
+
+    for (FusedStage * next = stage.next.load (); next && n_run < MAX_STAGES;
+     next = next->next.load ())
+    {
+        /* links that are being updated could briefly form a loop */
+        if (std::find (run, run + n_run, next) != run + n_run)
+            break;
+
+        next->users.fetch_add (1);
+
+        if (! (next->active.load () && next->channels.load () == channels &&
+         next->rate.load () == rate))
+        {
+            next->users.fetch_sub (1);
+            break;
+        }
+
+        run[n_run ++] = next;
+    }
+
+    if (n_run == 1)
+    {
+        stage.process (data.begin (), frames);
+        return;
+    }
+
+    int tile = aud::max (TILE_SAMPLES / channels, 1);
+    float * f = data.begin ();
+
+    for (int done = 0; done < frames; done += tile)
+    {
+        int len = aud::min (tile, frames - done);
+
+        for (int i = 0; i < n_run; i ++)
+            run[i]->process (f + done * channels, len);
+    }
+
+    for (int i = 1; i < n_run; i ++)
+    {
+        run[i]->led.store (true);
+        run[i]->users.fetch_sub (1);
+    }
+}
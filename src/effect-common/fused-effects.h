@@ -0,0 +1,75 @@
+/*
+ * fused-effects.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_FUSED_EFFECTS_H
+#define EFFECT_COMMON_FUSED_EFFECTS_H
+
+#include <atomic>
+
+#include <libaudcore/index.h>
+
+class EffectPlugin;
+
+// The simple per-sample effects (crystalizer, extra stereo, voice removal,
+// bs2b and echo) each describe their processing as a stage.  When several of
+// them follow one another in the effect chain, with no other effect between
+// them, the first of them leads: it runs all of the stages in a single pass
+// over each block, one cache-sized tile at a time, in the order of the chain,
+// while the others pass their input through unchanged.  Stages find each
+// other through a hook, since every plugin is a separate module.
+//
+// The chain is looked up on the main thread, whenever a stage is enabled or
+// disabled and once a second after that, since other effects can be added to
+// it or removed from it without restarting it.  It is also looked up when the
+// chain is started.  Each stage then publishes the stage that follows it, so
+// that the audio thread only follows these links, without locking.  A stage is
+// only run by the leader while both see the same channel count and rate;
+// otherwise it runs by itself.
+
+struct FusedStage
+{
+    typedef void (* ProcessFunc) (float * data, int frames);
+
+    FusedStage (const EffectPlugin & plugin, ProcessFunc process) :
+        plugin (& plugin), process (process) {}
+
+    const EffectPlugin * const plugin;
+    const ProcessFunc process;
+
+    std::atomic<FusedStage *> next {nullptr};  // directly after this one
+    std::atomic<bool> active {false};
+    std::atomic<int> channels {0}, rate {0};
+
+    std::atomic<bool> led {false};  // set by the leader once it has run this block
+    std::atomic<int> users {0};     // leaders running this stage right now
+};
+
+// to be called from init() and cleanup(); fused_unregister() waits until no
+// leader is running the stage any more
+void fused_register (FusedStage & stage);
+void fused_unregister (FusedStage & stage);
+
+// to be called from start()
+void fused_start (FusedStage & stage, int channels, int rate);
+
+// to be called from process(); runs either this stage alone, all the stages
+// that it leads, or nothing if the stage before it has already run it
+void fused_process (FusedStage & stage, Index<float> & data);
+
+#endif // EFFECT_COMMON_FUSED_EFFECTS_H
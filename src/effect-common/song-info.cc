@@ -0,0 +1,448 @@
+/*
+ * song-info.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "song-info.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include <atomic>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/drct.h>
+#include <libaudcore/hook.h>
+#include <libaudcore/playlist.h>
+#include <libaudcore/runtime.h>
+
+/* The cache file has one group per song, keyed by its URI.  Results are kept
+ * in memory for the last few songs looked up, which is all that playback ever
+ * asks for. */
+
+#define CACHE_VERSION 1
+#define MAX_RESULTS 16
+#define PREFETCH_SONGS 3
+
+struct Values
+{
+    double v[SONG_INFO_MAX_VALUES];
+};
+
+struct Job
+{
+    String filename;
+    bool store;
+    Values values;
+};
+
+struct Result
+{
+    String filename;
+    bool found;
+    Values values;
+};
+
+struct Song
+{
+    String filename;
+    bool known = false;
+    bool confirmed = true;  // false while only expected to be playing
+    Values values {};
+};
+
+static const char * cache_name;
+static ArrayRef<const char *> cache_keys;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_t worker;
+static bool running, quit;
+
+/* protected by mutex */
+static Index<Job> jobs;
+static Index<Result> results;
+
+/* The song that is playing and the one expected to follow it.  These are set
+ * by the main thread when a song starts, completed by the worker when a
+ * lookup returns, and advanced by the audio thread at the end of each song,
+ * which comes before the next song starts.  The song expected next is only a
+ * guess, so its values are not passed on until the main thread confirms that
+ * it is the one playing.  Each change increments song_serial, so that the
+ * audio thread only needs to take the lock when something has changed.  Also
+ * protected by mutex. */
+static Song playing_song, next_song;
+static int song_count;
+static std::atomic<int> song_serial;
+
+/* used only by the worker */
+static GKeyFile * cache;
+
+static StringBuf cache_path ()
+{
+    return filename_build ({aud_get_path (AudPath::UserDir), cache_name});
+}
+
+static void load_cache ()
+{
+    cache = g_key_file_new ();
+
+    if (! g_key_file_load_from_file (cache, cache_path (), G_KEY_FILE_NONE, nullptr) ||
+     g_key_file_get_integer (cache, "cache", "version", nullptr) != CACHE_VERSION)
+    {
+        g_key_file_free (cache);
+        cache = g_key_file_new ();
+        g_key_file_set_integer (cache, "cache", "version", CACHE_VERSION);
+    }
+}
+
+static void save_cache ()
+{
+    gsize len;
+    char * data = g_key_file_to_data (cache, & len, nullptr);
+
+    GError * error = nullptr;
+    if (! g_file_set_contents (cache_path (), data, len, & error))
+    {
+        AUDERR ("Failed to write %s: %s\n", cache_name, error->message);
+        g_error_free (error);
+    }
+
+    g_free (data);
+}
+
+/* For local files, gets the size and modification time, leaving out any
+ * subtune number.  Other URIs are cached without them. */
+static bool file_stamp (const char * filename, int64_t & size, int64_t & mtime)
+{
+    size = mtime = 0;
+
+    const char * sub;
+    uri_parse (filename, nullptr, nullptr, & sub, nullptr);
+
+    StringBuf path = uri_to_filename (str_copy (filename, sub - filename));
+    if (! path)
+        return true;
+
+    GStatBuf info;
+    if (g_stat (path, & info) < 0)
+        return false;
+
+    size = info.st_size;
+    mtime = info.st_mtime;
+    return true;
+}
+
+static bool lookup (const char * filename, Values & values)
+{
+    int64_t size, mtime;
+    if (! g_key_file_has_group (cache, filename) || ! file_stamp (filename, size, mtime))
+        return false;
+
+    /* each call is made only if the ones before it succeeded */
+    GError * error = nullptr;
+
+    bool valid =
+     g_key_file_get_int64 (cache, filename, "size", & error) == size && ! error &&
+     g_key_file_get_int64 (cache, filename, "mtime", & error) == mtime && ! error;
+
+    for (int i = 0; valid && ! error && i < cache_keys.len; i ++)
+        values.v[i] = g_key_file_get_double (cache, filename, cache_keys.data[i], & error);
+
+    valid = valid && ! error;
+    g_clear_error (& error);
+
+    return valid;
+}
+
+static void store (const char * filename, const Values & values)
+{
+    int64_t size, mtime;
+    if (! file_stamp (filename, size, mtime))
+        return;
+
+    g_key_file_set_int64 (cache, filename, "size", size);
+    g_key_file_set_int64 (cache, filename, "mtime", mtime);
+
+    for (int i = 0; i < cache_keys.len; i ++)
+        g_key_file_set_double (cache, filename, cache_keys.data[i], values.v[i]);
+
+    save_cache ();
+}
+
+static Result * find_result_locked (const char * filename)
+{
+    for (Result & result : results)
+    {
+        if (! strcmp (result.filename, filename))
+            return & result;
+    }
+
+    return nullptr;
+}
+
+static void add_result_locked (const char * filename, bool found, const Values & values)
+{
+    Result * result = find_result_locked (filename);
+
+    if (! result)
+    {
+        if (results.len () >= MAX_RESULTS)
+            results.remove (0, 1);
+
+        result = & results.append ();
+        result->filename = String (filename);
+    }
+
+    result->found = found;
+    result->values = values;
+}
+
+static void set_song_locked (Song & song, const char * filename)
+{
+    song.filename = String (filename);
+    song.known = false;
+    song.confirmed = true;
+
+    Result * result = filename ? find_result_locked (filename) : nullptr;
+
+    if (result && result->found)
+    {
+        song.known = true;
+        song.values = result->values;
+    }
+}
+
+static void found_locked (const char * filename, const Values & values)
+{
+    if (playing_song.filename && ! strcmp (playing_song.filename, filename))
+    {
+        playing_song.known = true;
+        playing_song.values = values;
+        song_serial ++;
+    }
+
+    if (next_song.filename && ! strcmp (next_song.filename, filename))
+    {
+        next_song.known = true;
+        next_song.values = values;
+    }
+}
+
+static void * worker_thread (void *)
+{
+    load_cache ();
+
+    pthread_mutex_lock (& mutex);
+
+    while (1)
+    {
+        while (! quit && ! jobs.len ())
+            pthread_cond_wait (& wake, & mutex);
+
+        if (quit)
+            break;
+
+        Job job = std::move (jobs[0]);
+        jobs.remove (0, 1);
+
+        pthread_mutex_unlock (& mutex);
+
+        Values values = job.values;
+        bool found = job.store;
+
+        if (job.store)
+            store (job.filename, values);
+        else
+            found = lookup (job.filename, values);
+
+        pthread_mutex_lock (& mutex);
+
+        add_result_locked (job.filename, found, values);
+
+        if (found && ! job.store)
+            found_locked (job.filename, values);
+    }
+
+    pthread_mutex_unlock (& mutex);
+
+    g_key_file_free (cache);
+    cache = nullptr;
+
+    return nullptr;
+}
+
+static void queue_locked (const char * filename, bool store, const Values & values)
+{
+    Job & job = jobs.append ();
+    job.filename = String (filename);
+    job.store = store;
+    job.values = values;
+
+    pthread_cond_broadcast (& wake);
+}
+
+/* queues a lookup of <filename>, unless it has already been looked up */
+static void prefetch_locked (const char * filename)
+{
+    for (const Job & job : jobs)
+    {
+        if (! strcmp (job.filename, filename))
+            return;
+    }
+
+    if (running && ! find_result_locked (filename))
+        queue_locked (filename, false, Values ());
+}
+
+static void playback_ready (void *, void *)
+{
+    String filename = aud_drct_get_filename ();
+    if (! filename)
+        return;
+
+    auto playlist = Playlist::playing_playlist ();
+    int pos = playlist.get_position ();
+    int entries = playlist.n_entries ();
+    int queued = playlist.n_queued ();
+
+    /* queued entries play first; after them, in shuffle mode, there is no
+     * telling which entry comes next */
+    Index<String> upcoming;
+    for (int i = 0; i < queued && upcoming.len () < PREFETCH_SONGS; i ++)
+        upcoming.append (playlist.entry_filename (playlist.queue_get_entry (i)));
+
+    if (! aud_get_bool (nullptr, "shuffle"))
+    {
+        for (int i = 1; upcoming.len () < PREFETCH_SONGS && pos >= 0 && pos + i < entries; i ++)
+            upcoming.append (playlist.entry_filename (pos + i));
+    }
+
+    pthread_mutex_lock (& mutex);
+
+    /* the playing song first, since the worker takes them in order */
+    prefetch_locked (filename);
+
+    for (const String & entry : upcoming)
+        prefetch_locked (entry);
+
+    /* usually already expected at the end of the previous song */
+    if (playing_song.filename && ! strcmp (playing_song.filename, filename))
+    {
+        if (! playing_song.confirmed)
+        {
+            playing_song.confirmed = true;
+            song_serial ++;
+        }
+    }
+    else
+    {
+        set_song_locked (playing_song, filename);
+        song_count ++;
+        song_serial ++;
+    }
+
+    set_song_locked (next_song, upcoming.len () ? (const char *) upcoming[0] : nullptr);
+
+    pthread_mutex_unlock (& mutex);
+}
+
+void song_info_init (const char * name, ArrayRef<const char *> keys)
+{
+    cache_name = name;
+    cache_keys = keys;
+
+    if (cache_keys.len > SONG_INFO_MAX_VALUES)
+        cache_keys.len = SONG_INFO_MAX_VALUES;
+
+    quit = false;
+
+    running = ! pthread_create (& worker, nullptr, worker_thread, nullptr);
+    if (! running)
+        AUDERR ("Failed to start worker thread.\n");
+
+    hook_associate ("playback ready", playback_ready, nullptr);
+
+    if (aud_drct_get_playing ())
+        playback_ready (nullptr, nullptr);
+}
+
+void song_info_cleanup ()
+{
+    hook_dissociate ("playback ready", playback_ready);
+
+    pthread_mutex_lock (& mutex);
+    quit = true;
+    pthread_cond_broadcast (& wake);
+    pthread_mutex_unlock (& mutex);
+
+    if (running)
+        pthread_join (worker, nullptr);
+
+    running = false;
+
+    /* pending stores are lost, but only ever one song's worth */
+    jobs.clear ();
+    results.clear ();
+
+    playing_song = Song ();
+    next_song = Song ();
+}
+
+bool song_info_update (SongInfo & info)
+{
+    if (song_serial.load () == info.serial)
+        return false;
+
+    pthread_mutex_lock (& mutex);
+
+    info.serial = song_serial.load ();
+    info.song = song_count;
+    info.known = playing_song.known && playing_song.confirmed;
+
+    for (int i = 0; i < SONG_INFO_MAX_VALUES; i ++)
+        info.values[i] = playing_song.values.v[i];
+
+    pthread_mutex_unlock (& mutex);
+    return true;
+}
+
+void song_info_finish (const double * values)
+{
+    pthread_mutex_lock (& mutex);
+
+    if (values && playing_song.filename && running)
+    {
+        Values stored {};
+        for (int i = 0; i < cache_keys.len; i ++)
+            stored.v[i] = values[i];
+
+        AUDDBG ("Storing %s for %s.\n", cache_name, (const char *) playing_song.filename);
+        queue_locked (playing_song.filename, true, stored);
+    }
+
+    playing_song = std::move (next_song);
+    playing_song.confirmed = false;
+    next_song = Song ();
+    song_count ++;
+    song_serial ++;
+
+    pthread_mutex_unlock (& mutex);
+}
@@ -0,0 +1,64 @@
+/*
+ * song-info.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef EFFECT_COMMON_SONG_INFO_H
+#define EFFECT_COMMON_SONG_INFO_H
+
+#include <libaudcore/objects.h>
+
+// Values that an effect measures over the whole of a song, and wants to have
+// at hand from the first sample the next time the song is played.  They are
+// kept in a cache file of the effect's own, keyed by URI.  Local files are
+// checked against their size and modification time, so that a file which
+// has changed is measured again.
+//
+// All disk access is done by a worker thread.  Whenever a song starts, it is
+// looked up, along with the entries that follow it in the playlist, so that
+// neither the audio thread nor the main thread ever waits for the disk, and
+// the values are ready even when one song follows another without a gap.
+
+#define SONG_INFO_MAX_VALUES 4
+
+struct SongInfo
+{
+    int serial = -1;     // for song_info_update()
+    int song = -1;       // changes whenever a different song starts playing
+    bool known = false;  // whether <values> were found in the cache
+    double values[SONG_INFO_MAX_VALUES] {};
+};
+
+// To be called from init() and cleanup().  <cache_name> is the name of the
+// cache file in the user's config directory, and <keys> the names of the
+// values kept for each song.
+void song_info_init (const char * cache_name, ArrayRef<const char *> keys);
+void song_info_cleanup ();
+
+// Audio thread: returns true, and updates <info>, if the playing song has
+// changed or its values have been found since <info> was last updated.  A
+// default-constructed SongInfo is always updated.
+bool song_info_update (SongInfo & info);
+
+// Audio thread: to be called at the end of each song, from finish().  Stores
+// <values>, if not null, as measured over the whole song, and moves on to the
+// song expected to follow it.  Its values are withheld until it is confirmed
+// to be playing, since shuffle or a change to the playlist can prove the
+// guess wrong.
+void song_info_finish (const double * values);
+
+#endif // EFFECT_COMMON_SONG_INFO_H
@@ -52,11 +52,9 @@ public:
     bool play(const char *filename, VFSFile &file);
 };
 
-#define BUFFER_SIZE_SAMP (FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS)
-#define BUFFER_SIZE_BYTE (BUFFER_SIZE_SAMP * (FLAC__MAX_BITS_PER_SAMPLE/8))
-
-#define SAMPLE_SIZE(a) (a == 8 ? 1 : (a == 16 ? 2 : 4))
-#define SAMPLE_FMT(a) (a == 8 ? FMT_S8 : (a == 16 ? FMT_S16_NE : (a == 24 ? FMT_S24_NE : FMT_S32_NE)))
+/* Decoded frames are collected until there are at least this many samples per
+ * channel, and then passed on in a single write_audio() call. */
+#define OUTPUT_BATCH_FRAMES 16384
 
 struct callback_info
 {
@@ -64,22 +62,14 @@ struct callback_info
     unsigned sample_rate = 0;
     unsigned channels = 0;
     unsigned long total_samples = 0;
-    Index<int32_t> output_buffer;
-    int32_t *write_pointer = nullptr;
+    Index<float> output_buffer;
     unsigned buffer_used = 0;
     VFSFile *fd = nullptr;
     int bitrate = 0;
 
-    void alloc()
-    {
-        output_buffer.resize(BUFFER_SIZE_SAMP);
-        reset();
-    }
-
     void reset()
     {
         buffer_used = 0;
-        write_pointer = output_buffer.begin();
     }
 };
 
@@ -258,121 +258,259 @@ static void parse_comment (Tuple & tuple, const char * key, const char * value)
         tuple.set_gain(Tuple::AlbumPeak, Tuple::PeakDivisor, value);
 }
 
+/*
+ * Tags are read by walking the metadata block headers directly, rather than
+ * through a libFLAC metadata chain, which would load every block into memory.
+ * Only the blocks that are needed are read; all others (padding, seek tables,
+ * and pictures when no image is wanted, which can run to megabytes) are
+ * skipped over with a seek.
+ */
+
+static uint32_t read_be(const unsigned char *p, int bytes)
+{
+    uint32_t value = 0;
+
+    for (int i = 0; i < bytes; i++)
+        value = (value << 8) | p[i];
+
+    return value;
+}
+
+static uint32_t read_le32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static bool read_bytes(VFSFile &file, Index<char> &buf, int64_t len)
+{
+    buf.resize(len);
+    return file.fread(buf.begin(), 1, len) == len;
+}
+
+static bool skip_bytes(VFSFile &file, int64_t len)
+{
+    if (file.fseek(len, VFS_SEEK_CUR) == 0)
+        return true;
+
+    /* some streams can only be read forward */
+    char buf[4096];
+
+    while (len > 0)
+    {
+        int64_t chunk = aud::min(len, (int64_t) sizeof buf);
+        if (file.fread(buf, 1, chunk) != chunk)
+            return false;
+
+        len -= chunk;
+    }
+
+    return true;
+}
+
+/* positions <file> just past the "fLaC" marker, skipping any ID3v2 tag */
+static bool find_stream_marker(VFSFile &file)
+{
+    unsigned char header[10];
+
+    if (file.fseek(0, VFS_SEEK_SET) != 0 || file.fread(header, 1, 4) != 4)
+        return false;
+
+    if (!memcmp(header, "ID3", 3))
+    {
+        if (file.fread(header + 4, 1, 6) != 6)
+            return false;
+
+        int64_t size = 10 + ((header[6] & 0x7f) << 21) + ((header[7] & 0x7f) << 14) +
+         ((header[8] & 0x7f) << 7) + (header[9] & 0x7f);
+
+        if (header[5] & 0x10) /* footer present */
+            size += 10;
+
+        if (!skip_bytes(file, size - 10) || file.fread(header, 1, 4) != 4)
+            return false;
+    }
+
+    return !memcmp(header, "fLaC", 4);
+}
+
+static void parse_stream_info(Tuple &tuple, VFSFile &file, const unsigned char *p)
+{
+    unsigned sample_rate = (p[10] << 12) | (p[11] << 4) | (p[12] >> 4);
+    unsigned channels = ((p[12] >> 1) & 7) + 1;
+    uint64_t total_samples = ((uint64_t) (p[13] & 0xf) << 32) | read_be(p + 14, 4);
+
+    /* Calculate the stream length (milliseconds) */
+    if (sample_rate == 0)
+    {
+        AUDERR("Invalid sample rate for stream!\n");
+        tuple.set_int (Tuple::Length, -1);
+    }
+    else
+    {
+        tuple.set_int (Tuple::Length, (total_samples / sample_rate) * 1000);
+        AUDDBG("Stream length: %d seconds\n", tuple.get_int (Tuple::Length));
+    }
+
+    int64_t size = file.fsize ();
+
+    if (size < 0 || total_samples == 0)
+        tuple.set_int (Tuple::Bitrate, 0);
+    else
+    {
+        int bitrate = 8 * size * (int64_t) sample_rate / total_samples;
+        tuple.set_int (Tuple::Bitrate, (bitrate + 500) / 1000);
+    }
+
+    tuple.set_int(Tuple::Channels, channels);
+}
+
+static bool parse_vorbis_comment(Tuple &tuple, const Index<char> &block)
+{
+    auto p = (const unsigned char *) block.begin();
+    auto end = p + block.len();
+
+    if (end - p < 4 || read_le32(p) > (uint32_t) (end - p - 4))
+        return false;
+
+    AUDDBG("Vendor string: %.*s\n", (int) read_le32(p), (const char *) p + 4);
+
+    p += 4 + read_le32(p);
+
+    if (end - p < 4)
+        return false;
+
+    uint32_t count = read_le32(p);
+    p += 4;
+
+    AUDDBG("Vorbis comment contains %d fields\n", (int) count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (end - p < 4 || read_le32(p) > (uint32_t) (end - p - 4))
+            return false;
+
+        uint32_t len = read_le32(p);
+        StringBuf entry = str_copy((const char *) p + 4, len);
+        p += 4 + len;
+
+        char *value = strchr(entry, '=');
+        if (!value)
+        {
+            AUDDBG("Could not parse comment\n");
+            continue;
+        }
+
+        *value++ = 0;
+        parse_comment(tuple, entry, value);
+    }
+
+    return true;
+}
+
+/* <block> is the rest of a PICTURE block after its 4-byte type */
+static bool parse_picture(const Index<char> &block, Index<char> &image)
+{
+    auto p = (const unsigned char *) block.begin();
+    auto end = p + block.len();
+
+    /* MIME type, then description */
+    for (int i = 0; i < 2; i++)
+    {
+        if (end - p < 4 || read_be(p, 4) > (uint32_t) (end - p - 4))
+            return false;
+
+        p += 4 + read_be(p, 4);
+    }
+
+    /* width, height, depth, and colors, then the data */
+    if (end - p < 20 || read_be(p + 16, 4) > (uint32_t) (end - p - 20))
+        return false;
+
+    image.insert((const char *) p + 20, 0, read_be(p + 16, 4));
+    return true;
+}
+
 bool FLACng::read_tag (const char * filename, VFSFile & file, Tuple & tuple, Index<char> * image)
 {
     AUDDBG("Probe for tuple.\n");
 
-    FLAC__Metadata_Iterator *iter;
-    FLAC__Metadata_Chain *chain;
-    FLAC__StreamMetadata *metadata = nullptr;
-    FLAC__Metadata_ChainStatus status;
-    FLAC__StreamMetadata_VorbisComment_Entry *entry;
-    char *key;
-    char *value;
-
     tuple.set_str (Tuple::Codec, "Free Lossless Audio Codec (FLAC)");
     tuple.set_str (Tuple::Quality, _("lossless"));
 
-    chain = FLAC__metadata_chain_new();
+    if (!find_stream_marker(file))
+    {
+        AUDERR("Not a FLAC stream: %s\n", filename);
+        return false;
+    }
 
-    if (!FLAC__metadata_chain_read_with_callbacks(chain, &file, io_callbacks))
-        goto ERR;
+    Index<char> block;
+    bool last = false;
 
-    iter = FLAC__metadata_iterator_new();
+    while (!last)
+    {
+        unsigned char header[4];
+        if (file.fread(header, 1, sizeof header) != sizeof header)
+            goto ERR;
 
-    FLAC__metadata_iterator_init(iter, chain);
+        last = header[0] & 0x80;
+        unsigned type = header[0] & 0x7f;
+        uint32_t len = read_be(header + 1, 3);
 
-    do
-    {
-        switch (FLAC__metadata_iterator_get_block_type(iter))
+        switch (type)
         {
-            case FLAC__METADATA_TYPE_VORBIS_COMMENT:
-            {
-                metadata = FLAC__metadata_iterator_get_block(iter);
+            case FLAC__METADATA_TYPE_STREAMINFO:
+                if (len < 34 || !read_bytes(file, block, len))
+                    goto ERR;
 
-                AUDDBG("Vorbis comment contains %d fields\n", metadata->data.vorbis_comment.num_comments);
-                AUDDBG("Vendor string: %s\n", metadata->data.vorbis_comment.vendor_string.entry);
+                parse_stream_info(tuple, file, (const unsigned char *) block.begin());
+                break;
 
-                entry = metadata->data.vorbis_comment.comments;
+            case FLAC__METADATA_TYPE_VORBIS_COMMENT:
+                if (!read_bytes(file, block, len) || !parse_vorbis_comment(tuple, block))
+                    goto ERR;
 
-                for (unsigned i = 0; i < metadata->data.vorbis_comment.num_comments; i++, entry++)
-                {
-                    if (FLAC__metadata_object_vorbiscomment_entry_to_name_value_pair(*entry, &key, &value) == false)
-                        AUDDBG("Could not parse comment\n");
-                    else
-                    {
-                        parse_comment(tuple, key, value);
-                        free(key);
-                        free(value);
-                    }
-                }
                 break;
-            }
 
-            case FLAC__METADATA_TYPE_STREAMINFO:
+            case FLAC__METADATA_TYPE_PICTURE:
             {
-                metadata = FLAC__metadata_iterator_get_block(iter);
+                unsigned char picture_type[4];
 
-                /* Calculate the stream length (milliseconds) */
-                if (metadata->data.stream_info.sample_rate == 0)
+                if (!image || image->len() || len < 4)
                 {
-                    AUDERR("Invalid sample rate for stream!\n");
-                    tuple.set_int (Tuple::Length, -1);
-                }
-                else
-                {
-                    tuple.set_int (Tuple::Length,
-                        (metadata->data.stream_info.total_samples / metadata->data.stream_info.sample_rate) * 1000);
-                    AUDDBG("Stream length: %d seconds\n", tuple.get_int (Tuple::Length));
+                    if (!skip_bytes(file, len))
+                        goto ERR;
+
+                    break;
                 }
 
-                int64_t size = file.fsize ();
+                if (file.fread(picture_type, 1, 4) != 4)
+                    goto ERR;
 
-                if (size < 0 || metadata->data.stream_info.total_samples == 0)
-                    tuple.set_int (Tuple::Bitrate, 0);
-                else
+                if (read_be(picture_type, 4) != FLAC__STREAM_METADATA_PICTURE_TYPE_FRONT_COVER)
                 {
-                    int bitrate = 8 * size *
-                        (int64_t) metadata->data.stream_info.sample_rate / metadata->data.stream_info.total_samples;
+                    if (!skip_bytes(file, len - 4))
+                        goto ERR;
 
-                    tuple.set_int (Tuple::Bitrate, (bitrate + 500) / 1000);
+                    break;
                 }
 
-                if (metadata->data.stream_info.channels > 0)
-                    tuple.set_int(Tuple::Channels, metadata->data.stream_info.channels);
-                break;
-            }
+                AUDDBG("FLAC__STREAM_METADATA_PICTURE_TYPE_FRONT_COVER found.\n");
+
+                if (!read_bytes(file, block, len - 4) || !parse_picture(block, *image))
+                    goto ERR;
 
-            case FLAC__METADATA_TYPE_PICTURE:
-            {
-                if (image && !image->len())
-                {
-                    metadata = FLAC__metadata_iterator_get_block(iter);
-
-                    if (metadata->data.picture.type == FLAC__STREAM_METADATA_PICTURE_TYPE_FRONT_COVER)
-                    {
-                        AUDDBG("FLAC__STREAM_METADATA_PICTURE_TYPE_FRONT_COVER found.");
-                        image->insert((const char *) metadata->data.picture.data, 0,
-                         metadata->data.picture.data_length);
-                    }
-                }
                 break;
             }
 
             default:
-                ;
+                if (!skip_bytes(file, len))
+                    goto ERR;
         }
-    } while (FLAC__metadata_iterator_next(iter));
-
-    FLAC__metadata_iterator_delete(iter);
-    FLAC__metadata_chain_delete(chain);
+    }
 
     return true;
 
 ERR:
-    status = FLAC__metadata_chain_status(chain);
-    FLAC__metadata_chain_delete(chain);
-
-    AUDERR("An error occurred: %s\n", FLAC__Metadata_ChainStatusString[status]);
+    AUDERR("Invalid metadata in %s\n", filename);
     return false;
 }
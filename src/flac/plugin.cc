@@ -18,6 +18,7 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <pthread.h>
 #include <string.h>
 
 #include <libaudcore/runtime.h>
@@ -26,25 +27,43 @@
 
 EXPORT FLACng aud_plugin_instance;
 
-static FLAC__StreamDecoder *decoder;
-static callback_info *cinfo;
+/*
+ * Each call to play() gets a decoder and callback state of its own, so that
+ * any number of files can be decoded at once.  Decoders are handed back to a
+ * small pool when done with, so that a libFLAC decoder need not be created
+ * anew for every song.
+ */
 
-bool FLACng::init()
+#define MAX_POOLED_DECODERS 4
+
+struct decoder_state
 {
-    FLAC__StreamDecoderInitStatus ret;
+    FLAC__StreamDecoder *decoder = nullptr;
+    callback_info info;
 
-    /* Callback structure and decoder for main decoding loop */
+    ~decoder_state()
+    {
+        if (decoder)
+            FLAC__stream_decoder_delete(decoder);
+    }
+};
 
-    cinfo = new callback_info;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Index<SmartPtr<decoder_state>> pool;
 
-    if ((decoder = FLAC__stream_decoder_new()) == nullptr)
+static SmartPtr<decoder_state> new_decoder()
+{
+    FLAC__StreamDecoderInitStatus ret;
+    SmartPtr<decoder_state> state(new decoder_state);
+
+    if ((state->decoder = FLAC__stream_decoder_new()) == nullptr)
     {
-        AUDERR("Could not create the main FLAC decoder instance!\n");
-        return false;
+        AUDERR("Could not create a FLAC decoder instance!\n");
+        return SmartPtr<decoder_state>();
     }
 
     if (FLAC__STREAM_DECODER_INIT_STATUS_OK != (ret = FLAC__stream_decoder_init_stream(
-        decoder,
+        state->decoder,
         read_callback,
         seek_callback,
         tell_callback,
@@ -53,21 +72,58 @@ bool FLACng::init()
         write_callback,
         metadata_callback,
         error_callback,
-        cinfo)))
+        &state->info)))
     {
-        AUDERR("Could not initialize the main FLAC decoder: %s(%d)\n",
+        AUDERR("Could not initialize the FLAC decoder: %s(%d)\n",
             FLAC__StreamDecoderInitStatusString[ret], ret);
-        return false;
+        return SmartPtr<decoder_state>();
+    }
+
+    return state;
+}
+
+static SmartPtr<decoder_state> take_decoder()
+{
+    SmartPtr<decoder_state> state;
+
+    pthread_mutex_lock(&pool_mutex);
+
+    if (pool.len())
+    {
+        state = std::move(pool[pool.len() - 1]);
+        pool.remove(pool.len() - 1, 1);
     }
 
+    pthread_mutex_unlock(&pool_mutex);
+
+    return state ? std::move(state) : new_decoder();
+}
+
+/* a decoder that does not fit in the pool is deleted on return */
+static void give_back_decoder(SmartPtr<decoder_state> state)
+{
+    state->info.fd = nullptr;
+    state->info.reset();
+
+    pthread_mutex_lock(&pool_mutex);
+
+    if (pool.len() < MAX_POOLED_DECODERS)
+        pool.append(std::move(state));
+
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+bool FLACng::init()
+{
     AUDDBG("Plugin initialized.\n");
     return true;
 }
 
 void FLACng::cleanup()
 {
-    FLAC__stream_decoder_delete(decoder);
-    delete cinfo;
+    pthread_mutex_lock(&pool_mutex);
+    pool.clear();
+    pthread_mutex_unlock(&pool_mutex);
 }
 
 bool FLACng::is_our_file(const char *filename, VFSFile &file)
@@ -81,39 +137,14 @@ bool FLACng::is_our_file(const char *filename, VFSFile &file)
     return ! strncmp (buf, "fLaC", sizeof buf);
 }
 
-static void squeeze_audio(int32_t* src, void* dst, unsigned count, unsigned res)
-{
-    int32_t* rp = src;
-    int8_t*  wp = (int8_t*) dst;
-    int16_t* wp2 = (int16_t*) dst;
-    int32_t* wp4 = (int32_t*) dst;
-
-    switch (res)
-    {
-        case 8:
-            for (unsigned i = 0; i < count; i++, wp++, rp++)
-                *wp = *rp & 0xff;
-            break;
-
-        case 16:
-            for (unsigned i = 0; i < count; i++, wp2++, rp++)
-                *wp2 = *rp & 0xffff;
-            break;
-
-        case 24:
-        case 32:
-            for (unsigned i = 0; i < count; i++, wp4++, rp++)
-                *wp4 = *rp;
-            break;
-
-        default:
-            AUDERR("Can not convert to %u bps\n", res);
-    }
-}
-
 bool FLACng::play(const char *filename, VFSFile &file)
 {
-    Index<char> play_buffer;
+    SmartPtr<decoder_state> state = take_decoder();
+    if (!state)
+        return false;
+
+    FLAC__StreamDecoder *decoder = state->decoder;
+    callback_info *cinfo = &state->info;
     bool error = false;
 
     cinfo->fd = &file;
@@ -125,10 +156,8 @@ bool FLACng::play(const char *filename, VFSFile &file)
         goto ERR_NO_CLOSE;
     }
 
-    play_buffer.resize(BUFFER_SIZE_BYTE);
-
     set_stream_bitrate(cinfo->bitrate);
-    open_audio(SAMPLE_FMT(cinfo->bits_per_sample), cinfo->sample_rate, cinfo->channels);
+    open_audio(FMT_FLOAT, cinfo->sample_rate, cinfo->channels);
 
     while (FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_END_OF_STREAM)
     {
@@ -137,8 +166,12 @@ bool FLACng::play(const char *filename, VFSFile &file)
 
         int seek_value = check_seek ();
         if (seek_value >= 0)
+        {
+            /* anything still collected is from before the seek */
+            cinfo->reset();
             FLAC__stream_decoder_seek_absolute (decoder, (int64_t)
              seek_value * cinfo->sample_rate / 1000);
+        }
 
         /* Try to decode a single frame of audio */
         if (FLAC__stream_decoder_process_single(decoder) == false)
@@ -148,20 +181,24 @@ bool FLACng::play(const char *filename, VFSFile &file)
             break;
         }
 
-        squeeze_audio(cinfo->output_buffer.begin(), play_buffer.begin(),
-         cinfo->buffer_used, cinfo->bits_per_sample);
-        write_audio(play_buffer.begin(), cinfo->buffer_used *
-         SAMPLE_SIZE(cinfo->bits_per_sample));
-
-        cinfo->reset();
+        if (cinfo->buffer_used >= cinfo->channels * OUTPUT_BATCH_FRAMES)
+        {
+            write_audio(cinfo->output_buffer.begin(), cinfo->buffer_used * sizeof(float));
+            cinfo->reset();
+        }
     }
 
+    /* whatever is left over at the end of the stream */
+    if (cinfo->buffer_used && ! check_stop ())
+        write_audio(cinfo->output_buffer.begin(), cinfo->buffer_used * sizeof(float));
+
 ERR_NO_CLOSE:
     cinfo->reset();
 
     if (FLAC__stream_decoder_flush(decoder) == false)
         AUDERR("Could not flush decoder state!\n");
 
+    give_back_decoder(std::move(state));
     return ! error;
 }
 
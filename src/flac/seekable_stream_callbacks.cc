@@ -18,6 +18,7 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include <math.h>
 #include <string.h>
 #include <FLAC/all.h>
 
@@ -112,6 +113,66 @@ FLAC__StreamDecoderLengthStatus length_callback(const FLAC__StreamDecoder *decod
     return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
 }
 
+/* Four samples, mapped by the compiler onto SSE or NEON registers.  Loads and
+ * stores go through memcpy since the data is not necessarily aligned. */
+typedef int32_t v4i __attribute__ ((vector_size (16)));
+typedef float v4f __attribute__ ((vector_size (16)));
+
+static inline v4f load4_scaled(const FLAC__int32 *p, v4f scale)
+{
+    v4i i;
+    memcpy(&i, p, sizeof i);
+
+    v4f f = {(float) i[0], (float) i[1], (float) i[2], (float) i[3]};
+    return f * scale;
+}
+
+static inline void store4(float *p, v4f v)
+{
+    memcpy(p, &v, sizeof v);
+}
+
+/*
+ * Interleaves the channels of a decoded frame straight into floats, scaled
+ * to [-1, 1).  Mono and stereo, which is nearly everything, go four frames
+ * at a time; other layouts are converted one channel at a time.
+ */
+static void interleave_float(const FLAC__int32 *const buffer[], unsigned channels,
+ unsigned frames, unsigned bits, float *out)
+{
+    float scale = ldexpf(1, 1 - (int) bits);
+    v4f vscale = {scale, scale, scale, scale};
+    unsigned done = 0;
+
+    if (channels == 1)
+    {
+        for (; done + 4 <= frames; done += 4)
+            store4(out + done, load4_scaled(buffer[0] + done, vscale));
+    }
+    else if (channels == 2)
+    {
+        for (; done + 4 <= frames; done += 4)
+        {
+            v4f l = load4_scaled(buffer[0] + done, vscale);
+            v4f r = load4_scaled(buffer[1] + done, vscale);
+
+            v4f lo = {l[0], r[0], l[1], r[1]};
+            v4f hi = {l[2], r[2], l[3], r[3]};
+
+            store4(out + 2 * done, lo);
+            store4(out + 2 * done + 4, hi);
+        }
+    }
+
+    for (unsigned channel = 0; channel < channels; channel++)
+    {
+        const FLAC__int32 *in = buffer[channel];
+
+        for (unsigned sample = done; sample < frames; sample++)
+            out[sample * channels + channel] = in[sample] * scale;
+    }
+}
+
 FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
 {
     callback_info *info = (callback_info*) client_data;
@@ -122,17 +183,15 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
         return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     }
 
-    if (!info->output_buffer.len())
-        info->alloc();
+    /* frames are collected until the main loop passes them on */
+    unsigned samples = frame->header.blocksize * frame->header.channels;
+    if (info->buffer_used + samples > (unsigned) info->output_buffer.len())
+        info->output_buffer.resize(info->buffer_used + samples);
 
-    for (unsigned sample = 0; sample < frame->header.blocksize; sample++)
-    {
-        for (unsigned channel = 0; channel < frame->header.channels; channel++)
-        {
-            *(info->write_pointer++) = buffer[channel][sample];
-            info->buffer_used += 1;
-        }
-    }
+    interleave_float(buffer, frame->header.channels, frame->header.blocksize,
+     frame->header.bits_per_sample, info->output_buffer.begin() + info->buffer_used);
+
+    info->buffer_used += samples;
 
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
@@ -24,8 +24,26 @@
 
 #include <libaudcore/runtime.h>
 
+#define MAX_WORKERS 15
+
 static int ladspa_channels, ladspa_rate;
 
+/* A small pool of persistent worker threads, used to run the separate
+ * instances of a plugin (one for each group of channels) in parallel.  The
+ * audio thread hands out one instance at a time, takes part in the work
+ * itself, and waits until all instances are done.  The pool is started the
+ * first time it is needed and kept until the LADSPA host is shut down. */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_t pool_threads[MAX_WORKERS];
+static int pool_size = -1;  /* -1 = not started yet */
+static int pool_generation;
+static bool pool_quit;
+
+static LoadedPlugin * job_loaded;
+static int job_frames, job_next, job_count, job_pending;
+
 static void start_plugin (LoadedPlugin & loaded)
 {
     if (loaded.active)
@@ -34,27 +52,35 @@ static void start_plugin (LoadedPlugin & loaded)
     loaded.active = 1;
 
     PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
+    const LADSPA_Descriptor & desc = * plugin.desc;
 
     int ports = plugin.in_ports.len ();
 
     if (ports == 0 || ports != plugin.out_ports.len ())
     {
-        AUDERR ("Plugin has unusable port configuration: %s\n", desc.Name);
+        AUDERR ("Plugin has unusable port configuration: %s\n", (const char *) plugin.name);
         return;
     }
 
     if (ladspa_channels % ports != 0)
     {
         AUDERR ("Plugin cannot be used with %d channels: %s\n",
-         ladspa_channels, desc.Name);
+         ladspa_channels, (const char *) plugin.name);
         return;
     }
 
     int instances = ladspa_channels / ports;
 
+    /* unless the plugin forbids it, each channel is processed in place in a
+     * single buffer */
+    loaded.in_place = ! LADSPA_IS_INPLACE_BROKEN (desc.Properties);
+
     loaded.in_bufs.insert (0, ladspa_channels);
-    loaded.out_bufs.insert (0, ladspa_channels);
+    if (! loaded.in_place)
+        loaded.out_bufs.insert (0, ladspa_channels);
+
+    loaded.in_ptrs.insert (0, ladspa_channels);
+    loaded.out_ptrs.insert (0, ladspa_channels);
 
     for (int i = 0; i < instances; i ++)
     {
@@ -73,8 +99,9 @@ static void start_plugin (LoadedPlugin & loaded)
             in.insert (0, LADSPA_BUFLEN);
             desc.connect_port (handle, plugin.in_ports[p], in.begin ());
 
-            Index<float> & out = loaded.out_bufs[channel];
-            out.insert (0, LADSPA_BUFLEN);
+            Index<float> & out = loaded.in_place ? in : loaded.out_bufs[channel];
+            if (! loaded.in_place)
+                out.insert (0, LADSPA_BUFLEN);
             desc.connect_port (handle, plugin.out_ports[p], out.begin ());
         }
 
@@ -83,59 +110,192 @@ static void start_plugin (LoadedPlugin & loaded)
     }
 }
 
+static void run_instance (LoadedPlugin & loaded, int i, int frames)
+{
+    PluginData & plugin = loaded.plugin;
+    const LADSPA_Descriptor & desc = * plugin.desc;
+    LADSPA_Handle handle = loaded.instances[i];
+
+    int ports = plugin.in_ports.len ();
+
+    for (int done = 0; done < frames; done += LADSPA_BUFLEN)
+    {
+        for (int p = 0; p < ports; p ++)
+        {
+            int channel = ports * i + p;
+            desc.connect_port (handle, plugin.in_ports[p], loaded.in_ptrs[channel] + done);
+            desc.connect_port (handle, plugin.out_ports[p], loaded.out_ptrs[channel] + done);
+        }
+
+        desc.run (handle, aud::min (frames - done, LADSPA_BUFLEN));
+    }
+}
+
+/* called and returns with pool_mutex locked */
+static void work_locked ()
+{
+    while (job_next < job_count)
+    {
+        int i = job_next ++;
+
+        pthread_mutex_unlock (& pool_mutex);
+        run_instance (* job_loaded, i, job_frames);
+        pthread_mutex_lock (& pool_mutex);
+
+        if (! -- job_pending)
+            pthread_cond_signal (& pool_done);
+    }
+}
+
+static void * pool_worker (void *)
+{
+    pthread_mutex_lock (& pool_mutex);
+
+    int seen = pool_generation;
+
+    while (1)
+    {
+        while (! pool_quit && pool_generation == seen)
+            pthread_cond_wait (& pool_wake, & pool_mutex);
+
+        if (pool_quit)
+            break;
+
+        seen = pool_generation;
+        work_locked ();
+    }
+
+    pthread_mutex_unlock (& pool_mutex);
+    return nullptr;
+}
+
+static void start_workers ()
+{
+    int cores = g_get_num_processors ();
+    int wanted = aud::clamp (cores - 1, 0, MAX_WORKERS);
+
+    pool_quit = false;
+
+    for (pool_size = 0; pool_size < wanted; pool_size ++)
+    {
+        if (pthread_create (& pool_threads[pool_size], nullptr, pool_worker, nullptr))
+        {
+            AUDERR ("Failed to start worker thread.\n");
+            break;
+        }
+    }
+}
+
+void shutdown_workers ()
+{
+    pthread_mutex_lock (& pool_mutex);
+    pool_quit = true;
+    pthread_cond_broadcast (& pool_wake);
+    pthread_mutex_unlock (& pool_mutex);
+
+    for (int i = 0; i < pool_size; i ++)
+        pthread_join (pool_threads[i], nullptr);
+
+    pool_size = -1;
+}
+
+static void run_parallel (LoadedPlugin & loaded, int frames)
+{
+    pthread_mutex_lock (& pool_mutex);
+
+    job_loaded = & loaded;
+    job_frames = frames;
+    job_next = 0;
+    job_count = job_pending = loaded.instances.len ();
+
+    pool_generation ++;
+    pthread_cond_broadcast (& pool_wake);
+
+    work_locked ();
+
+    while (job_pending)
+        pthread_cond_wait (& pool_done, & pool_mutex);
+
+    job_loaded = nullptr;
+
+    pthread_mutex_unlock (& pool_mutex);
+}
+
 static void run_plugin (LoadedPlugin & loaded, float * data, int samples)
 {
     if (! loaded.instances.len ())
         return;
 
-    PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
-
-    int ports = plugin.in_ports.len ();
     int instances = loaded.instances.len ();
-    assert (ports * instances == ladspa_channels);
+    assert (loaded.plugin.in_ports.len () * instances == ladspa_channels);
 
-    while (samples / ladspa_channels > 0)
-    {
-        int frames = aud::min (samples / ladspa_channels, LADSPA_BUFLEN);
+    int frames = samples / ladspa_channels;
+    if (! frames)
+        return;
 
-        for (int i = 0; i < instances; i ++)
+    if (ladspa_channels == 1 && loaded.in_place)
+    {
+        /* mono: nothing to deinterleave, so run directly on the data */
+        loaded.in_ptrs[0] = loaded.out_ptrs[0] = data;
+    }
+    else
+    {
+        for (int channel = 0; channel < ladspa_channels; channel ++)
         {
-            LADSPA_Handle handle = loaded.instances[i];
+            Index<float> & in = loaded.in_bufs[channel];
+            if (in.len () < frames)
+                in.resize (frames);
+
+            loaded.in_ptrs[channel] = in.begin ();
 
-            for (int p = 0; p < ports; p ++)
+            if (loaded.in_place)
+                loaded.out_ptrs[channel] = in.begin ();
+            else
             {
-                int channel = ports * i + p;
-                float * get = data + channel;
-                float * in = loaded.in_bufs[channel].begin ();
-                float * in_end = in + frames;
-
-                while (in < in_end)
-                {
-                    * in ++ = * get;
-                    get += ladspa_channels;
-                }
+                Index<float> & out = loaded.out_bufs[channel];
+                if (out.len () < frames)
+                    out.resize (frames);
+
+                loaded.out_ptrs[channel] = out.begin ();
             }
 
-            desc.run (handle, frames);
+            float * get = data + channel;
+            float * set = loaded.in_ptrs[channel];
+            float * set_end = set + frames;
 
-            for (int p = 0; p < ports; p ++)
+            while (set < set_end)
             {
-                int channel = ports * i + p;
-                float * set = data + channel;
-                float * out = loaded.out_bufs[channel].begin ();
-                float * out_end = out + frames;
-
-                while (out < out_end)
-                {
-                    * set = * out ++;
-                    set += ladspa_channels;
-                }
+                * set ++ = * get;
+                get += ladspa_channels;
             }
         }
+    }
+
+    if (parallel_channels && instances > 1 && pool_size < 0)
+        start_workers ();
 
-        data += ladspa_channels * frames;
-        samples -= ladspa_channels * frames;
+    if (parallel_channels && instances > 1 && pool_size > 0)
+        run_parallel (loaded, frames);
+    else
+    {
+        for (int i = 0; i < instances; i ++)
+            run_instance (loaded, i, frames);
+    }
+
+    if (ladspa_channels == 1 && loaded.in_place)
+        return;
+
+    for (int channel = 0; channel < ladspa_channels; channel ++)
+    {
+        float * set = data + channel;
+        float * get = loaded.out_ptrs[channel];
+        float * get_end = get + frames;
+
+        while (get < get_end)
+        {
+            * set = * get ++;
+            set += ladspa_channels;
+        }
     }
 }
 
@@ -145,7 +305,7 @@ static void flush_plugin (LoadedPlugin & loaded)
         return;
 
     PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
+    const LADSPA_Descriptor & desc = * plugin.desc;
 
     int instances = loaded.instances.len ();
     for (int i = 0; i < instances; i ++)
@@ -167,7 +327,7 @@ void shutdown_plugin_locked (LoadedPlugin & loaded)
         return;
 
     PluginData & plugin = loaded.plugin;
-    const LADSPA_Descriptor & desc = plugin.desc;
+    const LADSPA_Descriptor & desc = * plugin.desc;
 
     int instances = loaded.instances.len ();
     for (int i = 0; i < instances; i ++)
@@ -183,6 +343,8 @@ void shutdown_plugin_locked (LoadedPlugin & loaded)
     loaded.instances.clear ();
     loaded.in_bufs.clear ();
     loaded.out_bufs.clear ();
+    loaded.in_ptrs.clear ();
+    loaded.out_ptrs.clear ();
 }
 
 void LADSPAHost::start (int & channels, int & rate)
@@ -0,0 +1,256 @@
+/*
+ * LADSPA Host for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <string.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/runtime.h>
+
+#include "plugin.h"
+
+/* The cache holds everything needed to list the plugins in each module and
+ * show their settings, so that a module is only opened once one of its
+ * plugins is enabled.  There is one group per module, keyed by its full
+ * path, which is used only if the size and modification time still match.
+ * Modules without any plugins are recorded too, so that they are not opened
+ * again either.  The cache is rewritten with every module found on each
+ * scan, whether it was read from the cache or opened, so modules that are no
+ * longer found drop out of it. */
+
+#define CACHE_VERSION 1
+
+static GKeyFile * old_cache, * new_cache;
+
+static StringBuf cache_path ()
+{
+    return filename_build ({aud_get_path (AudPath::UserDir), "ladspa-cache"});
+}
+
+void module_cache_begin ()
+{
+    old_cache = g_key_file_new ();
+    new_cache = g_key_file_new ();
+
+    if (! g_key_file_load_from_file (old_cache, cache_path (), G_KEY_FILE_NONE, nullptr) ||
+     g_key_file_get_integer (old_cache, "cache", "version", nullptr) != CACHE_VERSION)
+    {
+        g_key_file_free (old_cache);
+        old_cache = nullptr;
+    }
+
+    g_key_file_set_integer (new_cache, "cache", "version", CACHE_VERSION);
+}
+
+/* on failure, a plugin may have been appended; the caller removes it */
+static bool read_plugin (const char * module, int i)
+{
+    StringBuf key = str_printf ("%d.", i);
+    int key_len = key.len ();
+    auto k = [&] (const char * name) -> const char *
+        { key.resize (key_len); key.insert (-1, name); return key; };
+
+    GError * error = nullptr;
+
+    int index = g_key_file_get_integer (old_cache, module, k ("index"), & error);
+    char * label = g_key_file_get_string (old_cache, module, k ("label"), & error);
+    char * name = g_key_file_get_string (old_cache, module, k ("name"), & error);
+    int properties = g_key_file_get_integer (old_cache, module, k ("properties"), & error);
+
+    gsize n_counts = 0;
+    int * counts = g_key_file_get_integer_list (old_cache, module, k ("port_counts"), & n_counts, & error);
+
+    bool valid = ! error && n_counts == 3;
+    g_clear_error (& error);
+
+    const char * slash = strrchr (module, G_DIR_SEPARATOR);
+
+    if (! valid || ! slash || ! slash[1])
+    {
+        g_free (label);
+        g_free (name);
+        g_free (counts);
+        return false;
+    }
+
+    PluginData & plugin = * plugins.append (new PluginData (slash + 1, module, index, label, name));
+    plugin.properties = properties;
+
+    g_free (label);
+    g_free (name);
+
+    gsize len = 0;
+    int n_in = counts[0], n_out = counts[1], n_controls = counts[2];
+    g_free (counts);
+
+    int * ports = n_in ? g_key_file_get_integer_list (old_cache, module, k ("in_ports"), & len, nullptr) : nullptr;
+    for (int p = 0; p < aud::min (n_in, (int) len); p ++)
+        plugin.in_ports.append (ports[p]);
+    g_free (ports);
+
+    ports = n_out ? g_key_file_get_integer_list (old_cache, module, k ("out_ports"), & len, nullptr) : nullptr;
+    for (int p = 0; p < aud::min (n_out, (int) len); p ++)
+        plugin.out_ports.append (ports[p]);
+    g_free (ports);
+
+    if (n_controls)
+    {
+        gsize n_ports = 0, n_names = 0, n_toggles = 0, n_ranges = 0;
+
+        ports = g_key_file_get_integer_list (old_cache, module, k ("control_ports"), & n_ports, nullptr);
+        char * * names = g_key_file_get_string_list (old_cache, module, k ("control_names"), & n_names, nullptr);
+        gboolean * toggles = g_key_file_get_boolean_list (old_cache, module, k ("control_toggles"), & n_toggles, nullptr);
+        double * ranges = g_key_file_get_double_list (old_cache, module, k ("control_ranges"), & n_ranges, nullptr);
+
+        if (n_ports == (gsize) n_controls && n_names == n_ports &&
+         n_toggles == n_ports && n_ranges == 3 * n_ports)
+        {
+            for (int c = 0; c < n_controls; c ++)
+            {
+                ControlData control;
+                control.port = ports[c];
+                control.name = String (names[c]);
+                control.is_toggle = toggles[c];
+                control.min = ranges[3 * c];
+                control.max = ranges[3 * c + 1];
+                control.def = ranges[3 * c + 2];
+
+                plugin.controls.append (control);
+            }
+        }
+        else
+            valid = false;
+
+        g_free (ports);
+        g_strfreev (names);
+        g_free (toggles);
+        g_free (ranges);
+    }
+
+    return valid;
+}
+
+bool module_cache_read (const char * module, const GStatBuf & info)
+{
+    if (! old_cache || ! g_key_file_has_group (old_cache, module))
+        return false;
+
+    GError * error = nullptr;
+    gint64 size = g_key_file_get_int64 (old_cache, module, "size", & error);
+    gint64 mtime = g_key_file_get_int64 (old_cache, module, "mtime", & error);
+    int count = g_key_file_get_integer (old_cache, module, "plugins", & error);
+
+    if (error)
+    {
+        g_error_free (error);
+        return false;
+    }
+
+    if (size != (gint64) info.st_size || mtime != (gint64) info.st_mtime)
+        return false;
+
+    int first_plugin = plugins.len ();
+
+    for (int i = 0; i < count; i ++)
+    {
+        if (! read_plugin (module, i))
+        {
+            plugins.remove (first_plugin, -1);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void module_cache_write (const char * module, const GStatBuf & info, int first_plugin)
+{
+    g_key_file_set_int64 (new_cache, module, "size", info.st_size);
+    g_key_file_set_int64 (new_cache, module, "mtime", info.st_mtime);
+    g_key_file_set_integer (new_cache, module, "plugins", plugins.len () - first_plugin);
+
+    for (int i = first_plugin; i < plugins.len (); i ++)
+    {
+        PluginData & plugin = * plugins[i];
+
+        StringBuf key = str_printf ("%d.", i - first_plugin);
+        int key_len = key.len ();
+        auto k = [&] (const char * name) -> const char *
+            { key.resize (key_len); key.insert (-1, name); return key; };
+
+        g_key_file_set_integer (new_cache, module, k ("index"), plugin.index);
+        g_key_file_set_string (new_cache, module, k ("label"), plugin.label);
+        g_key_file_set_string (new_cache, module, k ("name"), plugin.name);
+        g_key_file_set_integer (new_cache, module, k ("properties"), plugin.properties);
+
+        int n_controls = plugin.controls.len ();
+        int counts[3] = {plugin.in_ports.len (), plugin.out_ports.len (), n_controls};
+        g_key_file_set_integer_list (new_cache, module, k ("port_counts"), counts, 3);
+
+        if (plugin.in_ports.len ())
+            g_key_file_set_integer_list (new_cache, module, k ("in_ports"),
+             plugin.in_ports.begin (), plugin.in_ports.len ());
+        if (plugin.out_ports.len ())
+            g_key_file_set_integer_list (new_cache, module, k ("out_ports"),
+             plugin.out_ports.begin (), plugin.out_ports.len ());
+
+        if (! n_controls)
+            continue;
+
+        Index<int> ports;
+        Index<const char *> names;
+        Index<gboolean> toggles;
+        Index<double> ranges;
+
+        for (const ControlData & control : plugin.controls)
+        {
+            ports.append (control.port);
+            names.append ((const char *) control.name);
+            toggles.append (control.is_toggle);
+            ranges.append (control.min);
+            ranges.append (control.max);
+            ranges.append (control.def);
+        }
+
+        g_key_file_set_integer_list (new_cache, module, k ("control_ports"), ports.begin (), n_controls);
+        g_key_file_set_string_list (new_cache, module, k ("control_names"), names.begin (), n_controls);
+        g_key_file_set_boolean_list (new_cache, module, k ("control_toggles"), toggles.begin (), n_controls);
+        g_key_file_set_double_list (new_cache, module, k ("control_ranges"), ranges.begin (), 3 * n_controls);
+    }
+}
+
+void module_cache_end ()
+{
+    gsize len;
+    char * data = g_key_file_to_data (new_cache, & len, nullptr);
+
+    GError * error = nullptr;
+    if (! g_file_set_contents (cache_path (), data, len, & error))
+    {
+        AUDERR ("Failed to write LADSPA module cache: %s\n", error->message);
+        g_error_free (error);
+    }
+
+    g_free (data);
+
+    if (old_cache)
+        g_key_file_free (old_cache);
+
+    g_key_file_free (new_cache);
+    old_cache = new_cache = nullptr;
+}
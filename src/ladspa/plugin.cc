@@ -36,10 +36,12 @@
 
 const char * const LADSPAHost::defaults[] = {
  "plugin_count", "0",
+ "parallel_channels", "FALSE",
  nullptr};
 
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 String module_path;
+bool parallel_channels;
 Index<GModule *> modules;
 Index<SmartPtr<PluginData>> plugins;
 Index<SmartPtr<LoadedPlugin>> loadeds;
@@ -104,13 +106,16 @@ static ControlData parse_control (const LADSPA_Descriptor & desc, int port)
     return control;
 }
 
-static void open_plugin (const char * path, const LADSPA_Descriptor & desc)
+static void open_plugin (const char * module, int index, const LADSPA_Descriptor & desc)
 {
-    const char * slash = strrchr (path, G_DIR_SEPARATOR);
+    const char * slash = strrchr (module, G_DIR_SEPARATOR);
     g_return_if_fail (slash && slash[1]);
     g_return_if_fail (desc.Label && desc.Name);
 
-    PluginData & plugin = * plugins.append (new PluginData (slash + 1, desc));
+    PluginData & plugin = * plugins.append
+     (new PluginData (slash + 1, module, index, desc.Label, desc.Name));
+
+    plugin.properties = desc.Properties;
 
     for (unsigned i = 0; i < desc.PortCount; i ++)
     {
@@ -125,30 +130,59 @@ static void open_plugin (const char * path, const LADSPA_Descriptor & desc)
     }
 }
 
-static GModule * open_module (const char * path)
+static LADSPA_Descriptor_Function get_descfun (GModule * handle)
+{
+    void * sym;
+    if (! g_module_symbol (handle, "ladspa_descriptor", & sym))
+        return nullptr;
+
+    return (LADSPA_Descriptor_Function) sym;
+}
+
+/* A module not listed in the cache is opened here only long enough to list
+ * its plugins.  Either way, it is opened for good only once one of its
+ * plugins is enabled (see load_plugin_locked). */
+static bool scan_module (const char * path)
 {
     GModule * handle = g_module_open (path, G_MODULE_BIND_LOCAL);
     if (! handle)
     {
         AUDERR ("Failed to open module %s: %s\n", path, g_module_error ());
-        return nullptr;
+        return false;
     }
 
-    void * sym;
-    if (! g_module_symbol (handle, "ladspa_descriptor", & sym))
+    LADSPA_Descriptor_Function descfun = get_descfun (handle);
+
+    if (descfun)
     {
+        const LADSPA_Descriptor * desc;
+        for (int i = 0; (desc = descfun (i)); i ++)
+            open_plugin (path, i, * desc);
+    }
+    else
         AUDERR ("Not a valid LADSPA module: %s\n", path);
-        g_module_close (handle);
-        return nullptr;
+
+    g_module_close (handle);
+    return true;
+}
+
+static void open_module (const char * path)
+{
+    GStatBuf info;
+    if (g_stat (path, & info) < 0)
+    {
+        AUDERR ("Failed to stat module %s: %s\n", path, strerror (errno));
+        return;
     }
 
-    LADSPA_Descriptor_Function descfun = (LADSPA_Descriptor_Function) sym;
+    int first_plugin = plugins.len ();
 
-    const LADSPA_Descriptor * desc;
-    for (int i = 0; (desc = descfun (i)); i ++)
-        open_plugin (path, * desc);
+    if (! module_cache_read (path, info) && ! scan_module (path))
+        return;
 
-    return handle;
+    /* carry every module over to the new cache, including invalid ones, so
+     * that we don't try them again */
+    module_cache_write (path, info, first_plugin);
 }
 
 static void open_modules_for_path (const char * path)
@@ -166,10 +200,7 @@ static void open_modules_for_path (const char * path)
         if (! str_has_suffix_nocase (name, G_MODULE_SUFFIX))
             continue;
 
-        GModule * handle = open_module (filename_build ({path, name}));
-
-        if (handle)
-            modules.append (handle);
+        open_module (filename_build ({path, name}));
     }
 
     g_dir_close (folder);
@@ -190,8 +221,10 @@ static void open_modules_for_paths (const char * paths)
 
 static void open_modules ()
 {
+    module_cache_begin ();
     open_modules_for_paths (getenv ("LADSPA_PATH"));
     open_modules_for_paths (module_path);
+    module_cache_end ();
 }
 
 static void close_modules ()
@@ -200,16 +233,65 @@ static void close_modules ()
 
     for (GModule * module : modules)
         g_module_close (module);
+
+    modules.clear ();
+}
+
+static bool load_plugin_locked (PluginData & plugin)
+{
+    if (plugin.desc)
+        return true;
+
+    GModule * handle = g_module_open (plugin.module, G_MODULE_BIND_LOCAL);
+    if (! handle)
+    {
+        AUDERR ("Failed to open module %s: %s\n", (const char *) plugin.module, g_module_error ());
+        return false;
+    }
+
+    LADSPA_Descriptor_Function descfun = get_descfun (handle);
+    if (! descfun)
+    {
+        AUDERR ("Not a valid LADSPA module: %s\n", (const char *) plugin.module);
+        g_module_close (handle);
+        return false;
+    }
+
+    /* The cache is only used while the size and modification time match, but
+     * check the labels anyway.  Every plugin of the module shares the handle. */
+    for (auto & other : plugins)
+    {
+        if (other->desc || strcmp (other->module, plugin.module))
+            continue;
+
+        const LADSPA_Descriptor * desc = descfun (other->index);
+        if (desc && desc->Label && ! strcmp (desc->Label, other->label))
+            other->desc = desc;
+    }
+
+    modules.append (handle);
+
+    if (! plugin.desc)
+    {
+        AUDERR ("Plugin %s not found in module %s\n", (const char *) plugin.label,
+         (const char *) plugin.module);
+        return false;
+    }
+
+    return true;
 }
 
-LoadedPlugin & enable_plugin_locked (PluginData & plugin)
+LoadedPlugin * enable_plugin_locked (PluginData & plugin)
 {
+    if (! load_plugin_locked (plugin))
+        return nullptr;
+
     LoadedPlugin & loaded = * loadeds.append (new LoadedPlugin (plugin));
 
     for (auto & control : plugin.controls)
         loaded.values.append (control.def);
 
-    return loaded;
+    return & loaded;
 }
 
 void disable_plugin_locked (LoadedPlugin & loaded)
@@ -224,7 +306,7 @@ static PluginData * find_plugin (const char * path, const char * label)
 {
     for (auto & plugin : plugins)
     {
-        if (! strcmp (plugin->path, path) && ! strcmp (plugin->desc.Label, label))
+        if (! strcmp (plugin->path, path) && ! strcmp (plugin->label, label))
             return plugin.get ();
     }
 
@@ -242,7 +324,7 @@ static void save_enabled_to_config ()
         LoadedPlugin & loaded = * loadeds[i];
 
         aud_set_str ("ladspa", str_printf ("plugin%d_path", i), loaded.plugin.path);
-        aud_set_str ("ladspa", str_printf ("plugin%d_label", i), loaded.plugin.desc.Label);
+        aud_set_str ("ladspa", str_printf ("plugin%d_label", i), loaded.plugin.label);
 
         Index<double> temp;
         temp.insert (0, loaded.values.len ());
@@ -277,22 +359,24 @@ static void load_enabled_from_config ()
         if (! plugin)
             continue;
 
-        LoadedPlugin & loaded = enable_plugin_locked (* plugin);
+        LoadedPlugin * loaded = enable_plugin_locked (* plugin);
+        if (! loaded)
+            continue;
 
         String controls = aud_get_str ("ladspa", str_printf ("plugin%d_controls", i));
 
         Index<double> temp;
-        temp.insert (0, loaded.values.len ());
+        temp.insert (0, loaded->values.len ());
 
         if (str_to_double_array (controls, temp.begin (), temp.len ()))
-            std::copy (temp.begin (), temp.end (), loaded.values.begin ());
+            std::copy (temp.begin (), temp.end (), loaded->values.begin ());
         else
         {
             /* migrate from old config format */
             for (int ci = 0; ci < temp.len (); ci ++)
             {
                 StringBuf key = str_printf ("plugin%d_control%d", i, ci);
-                loaded.values[ci] = aud_get_double ("ladspa", key);
+                loaded->values[ci] = aud_get_double ("ladspa", key);
                 aud_set_str ("ladspa", key, "");
             }
         }
@@ -306,6 +390,7 @@ bool LADSPAHost::init ()
     aud_config_set_defaults ("ladspa", defaults);
 
     module_path = aud_get_str ("ladspa", "module_path");
+    parallel_channels = aud_get_bool ("ladspa", "parallel_channels");
 
     open_modules ();
     load_enabled_from_config ();
@@ -329,6 +414,8 @@ void LADSPAHost::cleanup ()
     module_path = String ();
 
     pthread_mutex_unlock (& mutex);
+
+    shutdown_workers ();
 }
 
 static void set_module_path (GtkEntry * entry)
@@ -351,6 +438,17 @@ static void set_module_path (GtkEntry * entry)
         update_loaded_list (loaded_list);
 }
 
+static void parallel_toggled (GtkToggleButton * toggle)
+{
+    bool parallel = gtk_toggle_button_get_active (toggle);
+
+    pthread_mutex_lock (& mutex);
+    parallel_channels = parallel;
+    pthread_mutex_unlock (& mutex);
+
+    aud_set_bool ("ladspa", "parallel_channels", parallel);
+}
+
 static void enable_selected ()
 {
     pthread_mutex_lock (& mutex);
@@ -412,7 +510,7 @@ static void configure_plugin (LoadedPlugin & loaded)
 
     PluginData & plugin = loaded.plugin;
 
-    StringBuf title = str_printf (_("%s Settings"), plugin.desc.Name);
+    StringBuf title = str_printf (_("%s Settings"), (const char *) plugin.name);
     loaded.settings_win = gtk_dialog_new_with_buttons (title, nullptr,
      (GtkDialogFlags) 0, _("_Close"), GTK_RESPONSE_CLOSE, nullptr);
     gtk_window_set_resizable ((GtkWindow *) loaded.settings_win, 0);
@@ -493,6 +591,11 @@ static void * make_config_widget ()
     GtkWidget * entry = gtk_entry_new ();
     gtk_box_pack_start ((GtkBox *) hbox, entry, 1, 1, 0);
 
+    GtkWidget * parallel = gtk_check_button_new_with_label
+     (_("Process channels in parallel on multiple cores"));
+    gtk_toggle_button_set_active ((GtkToggleButton *) parallel, parallel_channels);
+    gtk_box_pack_start ((GtkBox *) vbox, parallel, 0, 0, 0);
+
     hbox = gtk_hbox_new (false, 6);
     gtk_box_pack_start ((GtkBox *) vbox, hbox, 1, 1, 0);
 
@@ -541,6 +644,7 @@ static void * make_config_widget ()
         gtk_entry_set_text ((GtkEntry *) entry, module_path);
 
     g_signal_connect (entry, "activate", (GCallback) set_module_path, nullptr);
+    g_signal_connect (parallel, "toggled", (GCallback) parallel_toggled, nullptr);
     g_signal_connect (plugin_list, "destroy", (GCallback) gtk_widget_destroyed, & plugin_list);
     g_signal_connect (enable_button, "clicked", (GCallback) enable_selected, nullptr);
     g_signal_connect (loaded_list, "destroy", (GCallback) gtk_widget_destroyed, & loaded_list);
@@ -21,6 +21,7 @@
 #define AUD_LADSPA_PLUGIN_H
 
 #include <pthread.h>
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 
 #include <libaudcore/i18n.h>
@@ -39,17 +40,28 @@ struct ControlData {
     float min, max, def;
 };
 
+/* Everything except the descriptor itself can be filled in from the module
+ * cache, so that a module is only opened once one of its plugins is used. */
 struct PluginData
 {
-    String path;
-    const LADSPA_Descriptor & desc;
+    String path;    /* file name of the module */
+    String module;  /* full path of the module */
+    int index;      /* position of the descriptor within the module */
+    String label, name;
+    int properties = 0;
     Index<ControlData> controls;
     Index<int> in_ports, out_ports;
     bool selected = false;
 
-    PluginData (const char * path, const LADSPA_Descriptor & desc) :
+    const LADSPA_Descriptor * desc = nullptr;
+
+    PluginData (const char * path, const char * module, int index,
+     const char * label, const char * name) :
         path (path),
-        desc (desc) {}
+        module (module),
+        index (index),
+        label (label),
+        name (name) {}
 };
 
 struct LoadedPlugin
@@ -58,8 +70,10 @@ struct LoadedPlugin
     Index<float> values;
     bool selected = false;
     bool active = false;
+    bool in_place = false;
     Index<LADSPA_Handle> instances;
     Index<Index<float>> in_bufs, out_bufs;
+    Index<float *> in_ptrs, out_ptrs;
     GtkWidget * settings_win = nullptr;
 
     LoadedPlugin (PluginData & plugin) :
@@ -100,6 +114,7 @@ public:
 
 extern pthread_mutex_t mutex;
 extern String module_path;
+extern bool parallel_channels;
 extern Index<GModule *> modules;
 extern Index<SmartPtr<PluginData>> plugins;
 extern Index<SmartPtr<LoadedPlugin>> loadeds;
@@ -107,12 +122,20 @@ extern Index<SmartPtr<LoadedPlugin>> loadeds;
 extern GtkWidget * plugin_list;
 extern GtkWidget * loaded_list;
 
-LoadedPlugin & enable_plugin_locked (PluginData & plugin);
+LoadedPlugin * enable_plugin_locked (PluginData & plugin);
 void disable_plugin_locked (LoadedPlugin & loaded);
 
+/* module-cache.c */
+
+void module_cache_begin ();
+bool module_cache_read (const char * module, const GStatBuf & info);
+void module_cache_write (const char * module, const GStatBuf & info, int first_plugin);
+void module_cache_end ();
+
 /* effect.c */
 
 void shutdown_plugin_locked (LoadedPlugin & loaded);
+void shutdown_workers ();
 
 /* plugin-list.c */
 
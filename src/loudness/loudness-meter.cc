@@ -0,0 +1,320 @@
+/*
+ * loudness-meter.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "loudness-meter.h"
+
+#include <math.h>
+
+#include <libaudcore/objects.h>
+
+/* channel weights for the WAVE layouts of 1 through 8 channels; the LFE
+ * channel is not counted, and surround channels are given +1.5 dB */
+static const float layout_weights[8][8] = {
+    {1},
+    {1, 1},
+    {1, 1, 1},
+    {1, 1, 1.41f, 1.41f},
+    {1, 1, 1, 1.41f, 1.41f},
+    {1, 1, 1, 0, 1.41f, 1.41f},
+    {1, 1, 1, 0, 1.41f, 1.41f, 1.41f},
+    {1, 1, 1, 0, 1.41f, 1.41f, 1.41f, 1.41f}
+};
+
+static double energy_to_lufs (double energy)
+    { return (energy > 0) ? -0.691 + 10 * log10 (energy) : -HUGE_VAL; }
+
+/* The two stages of the K filter, as given (for 48 kHz) in BS.1770, and
+ * converted to other rates as done by libebur128: a high shelf modelling the
+ * acoustic effect of the head, followed by a high pass. */
+static void k_filter (int rate, double (& coefs)[2][5])
+{
+    double f0 = 1681.974450955533;
+    double G = 3.999843853973347;
+    double Q = 0.7071752369554196;
+
+    double K = tan (M_PI * f0 / rate);
+    double Vh = pow (10, G / 20);
+    double Vb = pow (Vh, 0.4996667741545416);
+    double a0 = 1 + K / Q + K * K;
+
+    coefs[0][0] = (Vh + Vb * K / Q + K * K) / a0;
+    coefs[0][1] = 2 * (K * K - Vh) / a0;
+    coefs[0][2] = (Vh - Vb * K / Q + K * K) / a0;
+    coefs[0][3] = 2 * (K * K - 1) / a0;
+    coefs[0][4] = (1 - K / Q + K * K) / a0;
+
+    f0 = 38.13547087602444;
+    Q = 0.5003270373238773;
+    K = tan (M_PI * f0 / rate);
+    a0 = 1 + K / Q + K * K;
+
+    coefs[1][0] = 1;
+    coefs[1][1] = -2;
+    coefs[1][2] = 1;
+    coefs[1][3] = 2 * (K * K - 1) / a0;
+    coefs[1][4] = (1 - K / Q + K * K) / a0;
+}
+
+void LoudnessMeter::start (int channels, int rate)
+{
+    m_channels = channels;
+    m_rate = rate;
+    m_sub_frames = aud::max (rate / 10, 1);
+
+    m_weights.resize (channels);
+    for (int c = 0; c < channels; c ++)
+        m_weights[c] = (channels <= 8) ? layout_weights[channels - 1][c] : 1;
+
+    k_filter (rate, m_kcoefs);
+    m_filter.resize (4 * channels);
+
+    /* BS.1770 asks for at least 192 kHz after oversampling */
+    m_oversample = (rate < 96000) ? 4 : (rate < 192000) ? 2 : 1;
+
+    /* windowed sinc interpolator, split into one filter per phase */
+    int taps = peak_taps * m_oversample;
+    m_peak_coefs.resize (taps);
+
+    for (int p = 0; p < m_oversample; p ++)
+    {
+        float * coefs = & m_peak_coefs[p * peak_taps];
+        double sum = 0;
+
+        for (int k = 0; k < peak_taps; k ++)
+        {
+            int n = k * m_oversample + p;
+            double x = (n - (taps - 1) / 2.0) / m_oversample;
+            double sinc = (x == 0) ? 1 : sin (M_PI * x) / (M_PI * x);
+            double window = 0.5 + 0.5 * cos (2 * M_PI * (n - (taps - 1) / 2.0) / taps);
+
+            /* taps are stored in reverse, to match the history */
+            coefs[peak_taps - 1 - k] = sinc * window;
+            sum += sinc * window;
+        }
+
+        /* unity gain at DC, so that a constant level is not overestimated */
+        for (int k = 0; k < peak_taps; k ++)
+            coefs[k] /= sum;
+    }
+
+    m_peak_hist.resize (2 * peak_taps * channels);
+
+    reset ();
+}
+
+void LoudnessMeter::reset ()
+{
+    for (double & s : m_filter)
+        s = 0;
+    for (float & h : m_peak_hist)
+        h = 0;
+
+    m_peak_pos = 0;
+    m_peak = 0;
+
+    m_frames = 0;
+    m_sub_done = 0;
+    m_sub_energy = 0;
+    m_recent_head = m_recent_len = 0;
+
+    for (int b = 0; b < hist_bins; b ++)
+    {
+        m_hist_energy[b] = 0;
+        m_hist_count[b] = 0;
+    }
+}
+
+/* The history of each channel is kept twice over, so that the last
+ * <peak_taps> samples are always contiguous, starting at the write position. */
+void LoudnessMeter::measure_peak (int c, const float * data, int frames)
+{
+    float * hist = & m_peak_hist[2 * peak_taps * c];
+    int pos = m_peak_pos;
+    float peak = m_peak;
+
+    for (int i = 0; i < frames; i ++)
+    {
+        float x = data[i * m_channels];
+
+        hist[pos] = hist[pos + peak_taps] = x;
+        pos = (pos + 1) % peak_taps;
+
+        if (m_oversample == 1)
+        {
+            peak = aud::max (peak, fabsf (x));
+            continue;
+        }
+
+        const float * window = hist + pos;
+
+        for (int p = 0; p < m_oversample; p ++)
+        {
+            const float * coefs = & m_peak_coefs[p * peak_taps];
+            float sum = 0;
+
+            for (int k = 0; k < peak_taps; k ++)
+                sum += coefs[k] * window[k];
+
+            peak = aud::max (peak, fabsf (sum));
+        }
+    }
+
+    m_peak = peak;
+}
+
+void LoudnessMeter::process (const float * data, int frames)
+{
+    while (frames > 0)
+    {
+        int len = aud::min (frames, m_sub_frames - m_sub_done);
+
+        for (int c = 0; c < m_channels; c ++)
+        {
+            const double (& f1)[5] = m_kcoefs[0], (& f2)[5] = m_kcoefs[1];
+            double * s = & m_filter[4 * c];
+            double sum = 0;
+
+            for (int i = 0; i < len; i ++)
+            {
+                /* transposed direct form II */
+                double x = data[i * m_channels + c];
+                double y = f1[0] * x + s[0];
+                s[0] = f1[1] * x - f1[3] * y + s[1];
+                s[1] = f1[2] * x - f1[4] * y;
+
+                x = y;
+                y = f2[0] * x + s[2];
+                s[2] = f2[1] * x - f2[3] * y + s[3];
+                s[3] = f2[2] * x - f2[4] * y;
+
+                sum += y * y;
+            }
+
+            m_sub_energy += m_weights[c] * sum;
+            measure_peak (c, data + c, len);
+        }
+
+        m_peak_pos = (m_peak_pos + len) % peak_taps;
+
+        m_frames += len;
+        m_sub_done += len;
+
+        if (m_sub_done == m_sub_frames)
+            end_sub_block ();
+
+        data += len * m_channels;
+        frames -= len;
+    }
+}
+
+/* Each 100 ms sub-block completes a 400 ms block, overlapping the previous
+ * one by 75%, which goes into a histogram for the integrated loudness.  The
+ * histogram keeps the total energy in each bin, so the result is exact apart
+ * from blocks within 0.1 LU of the relative gate. */
+void LoudnessMeter::end_sub_block ()
+{
+    m_recent[(m_recent_head + m_recent_len) % max_sub_blocks] = m_sub_energy / m_sub_frames;
+
+    if (m_recent_len < max_sub_blocks)
+        m_recent_len ++;
+    else
+        m_recent_head = (m_recent_head + 1) % max_sub_blocks;
+
+    m_sub_done = 0;
+    m_sub_energy = 0;
+
+    if (m_recent_len < 4)
+        return;
+
+    double energy = 0;
+    for (int i = m_recent_len - 4; i < m_recent_len; i ++)
+        energy += m_recent[(m_recent_head + i) % max_sub_blocks];
+
+    energy /= 4;
+
+    int bin = (int) floor ((energy_to_lufs (energy) - LOUDNESS_SILENT) * 10);
+
+    if (bin >= 0)
+    {
+        bin = aud::min (bin, hist_bins - 1);
+        m_hist_energy[bin] += energy;
+        m_hist_count[bin] ++;
+    }
+}
+
+float LoudnessMeter::momentary () const
+{
+    if (m_recent_len < 4)
+        return LOUDNESS_SILENT;
+
+    double energy = 0;
+    for (int i = m_recent_len - 4; i < m_recent_len; i ++)
+        energy += m_recent[(m_recent_head + i) % max_sub_blocks];
+
+    return aud::max (energy_to_lufs (energy / 4), (double) LOUDNESS_SILENT);
+}
+
+float LoudnessMeter::short_term () const
+{
+    if (! m_recent_len)
+        return LOUDNESS_SILENT;
+
+    double energy = 0;
+    for (int i = 0; i < m_recent_len; i ++)
+        energy += m_recent[i];
+
+    return aud::max (energy_to_lufs (energy / m_recent_len), (double) LOUDNESS_SILENT);
+}
+
+float LoudnessMeter::integrated () const
+{
+    double energy = 0;
+    int count = 0;
+
+    for (int b = 0; b < hist_bins; b ++)
+    {
+        energy += m_hist_energy[b];
+        count += m_hist_count[b];
+    }
+
+    if (! count)
+        return LOUDNESS_SILENT;
+
+    double gate = energy_to_lufs (energy / count) - 10;
+    int first = aud::max ((int) ceil ((gate - LOUDNESS_SILENT) * 10), 0);
+
+    energy = 0;
+    count = 0;
+
+    for (int b = first; b < hist_bins; b ++)
+    {
+        energy += m_hist_energy[b];
+        count += m_hist_count[b];
+    }
+
+    if (! count)
+        return LOUDNESS_SILENT;
+
+    return energy_to_lufs (energy / count);
+}
+
+float LoudnessMeter::true_peak () const
+{
+    return (m_peak > 0) ? 20 * log10f (m_peak) : -HUGE_VALF;
+}
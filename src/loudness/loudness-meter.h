@@ -0,0 +1,90 @@
+/*
+ * loudness-meter.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef LOUDNESS_METER_H
+#define LOUDNESS_METER_H
+
+#include <stdint.h>
+
+#include <libaudcore/index.h>
+
+// Loudness as defined by ITU-R BS.1770-4 and EBU R128: the audio is passed
+// through the "K" weighting filter, and the mean square of each channel is
+// summed, with weights according to its position.  Momentary loudness is
+// measured over 400 ms, short-term loudness over 3 s, and integrated loudness
+// over everything since the last reset, leaving out blocks quieter than
+// -70 LUFS and then blocks more than 10 LU below the level of the remaining
+// ones.  The true peak is found by oversampling.
+
+// reported for silence, which is the absolute gate
+#define LOUDNESS_SILENT -70.0f
+
+class LoudnessMeter
+{
+public:
+    // sets the format and resets the measurements
+    void start (int channels, int rate);
+    void reset ();
+
+    void process (const float * data, int frames);
+
+    // in LUFS
+    float momentary () const;
+    float short_term () const;
+    float integrated () const;
+
+    // in dBTP
+    float true_peak () const;
+
+    // length of the audio measured since the last reset
+    double seconds () const
+        { return (double) m_frames / m_rate; }
+
+private:
+    static constexpr int max_sub_blocks = 30;  // 3 s in 100 ms steps
+    static constexpr int hist_bins = 1000;     // 0.1 LU from -70 to +30 LUFS
+    static constexpr int peak_taps = 12;       // per oversampling phase
+
+    void end_sub_block ();
+    void measure_peak (int c, const float * data, int frames);
+
+    int m_channels = 0, m_rate = 0;
+    int m_sub_frames = 0, m_oversample = 1;
+
+    Index<float> m_weights;
+    Index<double> m_filter;      // 4 state variables per channel
+    double m_kcoefs[2][5] {};    // K weighting, as two biquads
+
+    Index<float> m_peak_coefs;   // [phase][tap]
+    Index<float> m_peak_hist;    // 2 * peak_taps per channel
+    int m_peak_pos = 0;
+    float m_peak = 0;
+
+    int64_t m_frames = 0;
+    int m_sub_done = 0;          // frames in the current 100 ms
+    double m_sub_energy = 0;
+
+    double m_recent[max_sub_blocks] {};
+    int m_recent_head = 0, m_recent_len = 0;
+
+    double m_hist_energy[hist_bins] {};
+    int m_hist_count[hist_bins] {};
+};
+
+#endif // LOUDNESS_METER_H
@@ -0,0 +1,286 @@
+/*
+ * Loudness Normalization Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <math.h>
+
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+
+#include "../effect-common/effect-params.h"
+#include "../effect-common/song-info.h"
+#include "loudness-meter.h"
+
+/* Each song is measured as it plays (see loudness-meter.h), and its gain is
+ * set so as to bring its integrated loudness to the target, but never so far
+ * that its true peak would exceed the ceiling.
+ *
+ * The integrated loudness of a song is only known once it has been heard to
+ * the end, so the first time a song is played, the gain follows the loudness
+ * measured so far, slowly enough not to be heard as pumping.  At the end of
+ * the song the result is cached (see song-info.h), and the next time the
+ * song is played, the exact gain is used from the first sample, without any
+ * lookahead.  Entries coming up in the playlist are looked up ahead of time,
+ * so that the gain is ready even when one song follows another without a
+ * gap. */
+
+#define ADAPT_AFTER 3.0   /* seconds measured before following the loudness */
+#define ADAPT_RATE 1.0f   /* dB per second */
+#define MAX_CUT 30        /* dB */
+
+static const char * const loudness_defaults[] = {
+    "target", "-18",
+    "max_gain", "12",
+    "ceiling", "-1",
+    "use_cache", "TRUE",
+    nullptr
+};
+
+enum {
+    PARAM_TARGET,
+    PARAM_MAX_GAIN,
+    PARAM_CEILING,
+    PARAM_USE_CACHE
+};
+
+static const EffectParam loudness_param_list[] = {
+    {"target", EffectParam::Int},
+    {"max_gain", EffectParam::Int},
+    {"ceiling", EffectParam::Float},
+    {"use_cache", EffectParam::Bool}
+};
+
+static EffectParams loudness_params ("loudness", loudness_param_list);
+
+static void loudness_changed ()
+    { effect_settings_changed ("loudness"); }
+
+static const PreferencesWidget loudness_widgets[] = {
+    WidgetLabel (N_("<b>Normalization</b>")),
+    WidgetSpin (N_("Target loudness:"),
+        WidgetInt ("loudness", "target", loudness_changed),
+        {-31, -5, 1, N_("LUFS")}),
+    WidgetSpin (N_("Maximum gain:"),
+        WidgetInt ("loudness", "max_gain", loudness_changed),
+        {0, 24, 1, N_("dB")}),
+    WidgetSpin (N_("True peak ceiling:"),
+        WidgetFloat ("loudness", "ceiling", loudness_changed),
+        {-6, 0, 0.5, N_("dBTP")}),
+    WidgetLabel (N_("<b>Song Cache</b>")),
+    WidgetCheck (N_("Remember the loudness of each song"),
+        WidgetBool ("loudness", "use_cache", loudness_changed)),
+    WidgetLabel (N_("Songs played to the end are normalized exactly\n"
+                    "from the first sample the next time they are played."),
+        WIDGET_CHILD)
+};
+
+static const PluginPreferences loudness_prefs = {{loudness_widgets}};
+
+static const char loudness_about[] =
+ N_("Loudness Normalization Plugin for Audacious\n\n"
+    "Measures loudness according to EBU R128 (ITU-R BS.1770).");
+
+class Loudness : public EffectPlugin
+{
+public:
+    static constexpr PluginInfo info = {
+        N_("Loudness Normalization"),
+        PACKAGE,
+        loudness_about,
+        & loudness_prefs
+    };
+
+    /* order #0: alongside the compressor, before any resampling */
+    constexpr Loudness () : EffectPlugin (info, 0, true) {}
+
+    bool init ();
+    void cleanup ();
+
+    void start (int & channels, int & rate);
+    Index<float> & process (Index<float> & data);
+    bool flush (bool force);
+    Index<float> & finish (Index<float> & data, bool end_of_playlist);
+};
+
+EXPORT Loudness aud_plugin_instance;
+
+static const char * const cache_keys[] = {"integrated", "true_peak"};
+
+enum {
+    VALUE_INTEGRATED,
+    VALUE_TRUE_PEAK
+};
+
+/* used only by the audio thread */
+static LoudnessMeter meter;
+static int current_channels, current_rate;
+static SongInfo song;
+static bool whole_song;    /* measured from the start, without seeking */
+static float current_gain; /* dB */
+static bool gain_set;      /* false at the start of a song, so no ramp */
+
+bool Loudness::init ()
+{
+    aud_config_set_defaults ("loudness", loudness_defaults);
+    loudness_params.init ();
+    song_info_init ("loudness-cache", cache_keys);
+
+    return true;
+}
+
+void Loudness::cleanup ()
+{
+    song_info_cleanup ();
+    loudness_params.cleanup ();
+}
+
+void Loudness::start (int & channels, int & rate)
+{
+    current_channels = channels;
+    current_rate = rate;
+
+    meter.start (channels, rate);
+    whole_song = true;
+
+    song = SongInfo ();
+    current_gain = 0;
+    gain_set = false;
+}
+
+static void update_song ()
+{
+    int playing = song.song;
+    if (! song_info_update (song) || playing < 0 || song.song == playing)
+        return;
+
+    /* a song other than the one expected, or one started by hand, which the
+     * meter has measured since the end of the last song or the flush */
+    whole_song = true;
+    gain_set = false;
+}
+
+static float wanted_gain (int frames)
+{
+    float target = loudness_params.get (PARAM_TARGET);
+    float ceiling = loudness_params.get (PARAM_CEILING);
+    float gain = current_gain;
+
+    if (song.known && loudness_params.get_bool (PARAM_USE_CACHE))
+    {
+        gain = target - song.values[VALUE_INTEGRATED];
+        gain = aud::min (gain, ceiling - (float) song.values[VALUE_TRUE_PEAK]);
+    }
+    else
+    {
+        if (meter.seconds () >= ADAPT_AFTER && meter.integrated () > LOUDNESS_SILENT)
+        {
+            float goal = target - meter.integrated ();
+            float step = ADAPT_RATE * frames / current_rate;
+            gain = aud::clamp (goal, current_gain - step, current_gain + step);
+        }
+
+        /* the peaks measured so far (including this block) apply at once */
+        gain = aud::min (gain, ceiling - meter.true_peak ());
+    }
+
+    return aud::clamp (gain, (float) -MAX_CUT, loudness_params.get (PARAM_MAX_GAIN));
+}
+
+/* ramps linearly from the last gain to the new one over the block */
+static void apply_gain (float * data, int frames, float gain)
+{
+    if (! gain_set)
+    {
+        current_gain = gain;
+        gain_set = true;
+    }
+
+    float from = powf (10, current_gain / 20);
+    float to = powf (10, gain / 20);
+
+    current_gain = gain;
+
+    if (from == to)
+    {
+        if (to == 1)
+            return;
+
+        for (int i = 0; i < frames * current_channels; i ++)
+            data[i] *= to;
+
+        return;
+    }
+
+    float step = (to - from) / frames;
+
+    for (int f = 0; f < frames; f ++)
+    {
+        float g = from + step * (f + 1);
+
+        for (int c = 0; c < current_channels; c ++)
+            * data ++ *= g;
+    }
+}
+
+Index<float> & Loudness::process (Index<float> & data)
+{
+    int frames = data.len () / current_channels;
+    if (! frames)
+        return data;
+
+    update_song ();
+    meter.process (data.begin (), frames);
+    apply_gain (data.begin (), frames, wanted_gain (frames));
+
+    return data;
+}
+
+bool Loudness::flush (bool force)
+{
+    /* After a seek, the measurement no longer covers the whole song.  After a
+     * manual song change, it covers the previous one, and update_song() will
+     * count the new song as whole. */
+    if (meter.seconds () > 0)
+        whole_song = false;
+
+    meter.reset ();
+    return true;
+}
+
+Index<float> & Loudness::finish (Index<float> & data, bool end_of_playlist)
+{
+    process (data);
+
+    double values[] = {meter.integrated (), meter.true_peak ()};
+
+    AUDDBG ("%.1f LUFS integrated, %.1f LUFS short-term, %.1f dBTP\n",
+     values[VALUE_INTEGRATED], meter.short_term (), values[VALUE_TRUE_PEAK]);
+
+    bool store = whole_song && ! song.known && values[VALUE_INTEGRATED] > LOUDNESS_SILENT &&
+     loudness_params.get_bool (PARAM_USE_CACHE);
+
+    song_info_finish (store ? values : nullptr);
+
+    meter.reset ();
+    whole_song = true;
+    gain_set = false;
+
+    return data;
+}
@@ -0,0 +1 @@
+#include "../effect-common/channel-matrix.cc"
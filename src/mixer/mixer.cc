@@ -17,8 +17,6 @@
  * the use of this software.
  */
 
-/* TODO: implement more surround converters */
-
 #include <stdlib.h>
 
 #include <libaudcore/i18n.h>
@@ -26,6 +24,8 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/channel-matrix.h"
+
 class ChannelMixer : public EffectPlugin
 {
 public:
@@ -53,145 +53,26 @@ public:
 
 EXPORT ChannelMixer aud_plugin_instance;
 
-typedef Index<float> & (* Converter) (Index<float> & data);
-
-static Index<float> mixer_buf;
-
-static Index<float> & mono_to_stereo (Index<float> & data)
-{
-    int frames = data.len ();
-    mixer_buf.resize (2 * frames);
-
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
-
-    while (frames --)
-    {
-        float val = * get ++;
-        * set ++ = val;
-        * set ++ = val;
-    }
-
-    return mixer_buf;
-}
-
-static Index<float> & stereo_to_mono (Index<float> & data)
-{
-    int frames = data.len () / 2;
-    mixer_buf.resize (frames);
-
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
-
-    while (frames --)
-    {
-        float val = * get ++;
-        val += * get ++;
-        * set ++ = val / 2;
-    }
-
-    return mixer_buf;
-}
-
-static Index<float> & quadro_to_stereo (Index<float> & data)
-{
-    int frames = data.len () / 4;
-    mixer_buf.resize (2 * frames);
-
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
-
-    while (frames --)
-    {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float back_left   = * get ++;
-        float back_right  = * get ++;
-        * set ++ = front_left + (back_left * 0.7);
-        * set ++ = front_right + (back_right * 0.7);
-    }
-
-    return mixer_buf;
-}
-
-static Index<float> & surround_5p1_to_stereo (Index<float> & data)
-{
-    int frames = data.len () / 6;
-    mixer_buf.resize (2 * frames);
-
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
-
-    while (frames --)
-    {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float center = * get ++;
-        float lfe    = * get ++;
-        float rear_left   = * get ++;
-        float rear_right  = * get ++;
-        * set ++ = front_left + (center * 0.5) + (lfe * 0.5) + (rear_left * 0.5);
-        * set ++ = front_right + (center * 0.5) + (lfe * 0.5) + (rear_right * 0.5);
-    }
-
-    return mixer_buf;
-}
-
-/* 5 channels case. Quad + center channel */
-static Index<float> & quadro_5_to_stereo (Index<float> & data)
-{
-    int frames = data.len () / 5;
-    mixer_buf.resize (2 * frames);
-
-    float * get = data.begin ();
-    float * set = mixer_buf.begin ();
-
-    while (frames --)
-    {
-        float front_left  = * get ++;
-        float front_right = * get ++;
-        float center = * get ++;
-        float rear_left   = * get ++;
-        float rear_right  = * get ++;
-        * set ++ = front_left + (center * 0.5) + rear_left;
-        * set ++ = front_right + (center * 0.5) + rear_right;
-    }
-
-    return mixer_buf;
-}
-
-static Converter get_converter (int in, int out)
-{
-    if (in == 1 && out == 2)
-        return mono_to_stereo;
-    if (in == 2 && out == 1)
-        return stereo_to_mono;
-    if (in == 4 && out == 2)
-        return quadro_to_stereo;
-    if (in == 5 && out == 2)
-        return quadro_5_to_stereo;
-    if (in == 6 && out == 2)
-        return surround_5p1_to_stereo;
-
-    return nullptr;
-}
-
+/* The gain matrix and the kernel that applies it are chosen once in start().
+ * Any combination of channel counts is supported: the standard layouts (mono
+ * through 7.1) get proper downmix and upmix matrices, and larger counts are
+ * connected one-to-one. */
 static int input_channels, output_channels;
+static Index<float> matrix;
+static ChannelMatrixKernel kernel;
+static Index<float> mixer_buf;
 
 void ChannelMixer::start (int & channels, int & rate)
 {
     input_channels = channels;
     output_channels = aud_get_int ("mixer", "channels");
+    output_channels = aud::clamp (output_channels, 1, AUD_MAX_CHANNELS);
 
     if (input_channels == output_channels)
         return;
 
-    if (! get_converter (input_channels, output_channels))
-    {
-        AUDERR ("Converting %d to %d channels is not implemented.\n",
-         input_channels, output_channels);
-        return;
-    }
+    matrix = channel_matrix (input_channels, output_channels);
+    kernel = channel_matrix_kernel (input_channels, output_channels);
 
     channels = output_channels;
 }
@@ -201,11 +82,16 @@ Index<float> & ChannelMixer::process (Index<float> & data)
     if (input_channels == output_channels)
         return data;
 
-    Converter converter = get_converter (input_channels, output_channels);
-    if (converter)
-        return converter (data);
+    int frames = data.len () / input_channels;
+    mixer_buf.resize (frames * output_channels);
 
-    return data;
+    if (kernel)
+        kernel (matrix.begin (), data.begin (), mixer_buf.begin (), frames);
+    else
+        channel_matrix_apply (matrix.begin (), input_channels, output_channels,
+         data.begin (), mixer_buf.begin (), frames);
+
+    return mixer_buf;
 }
 
 const char * const ChannelMixer::defaults[] = {
@@ -220,6 +106,7 @@ bool ChannelMixer::init ()
 
 void ChannelMixer::cleanup ()
 {
+    matrix.clear ();
     mixer_buf.clear ();
 }
 
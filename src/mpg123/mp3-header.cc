@@ -0,0 +1,251 @@
+/*
+ * mp3-header.cc
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include "mp3-header.h"
+
+#include <string.h>
+
+#include <libaudcore/objects.h>
+#include <libaudcore/vfs.h>
+
+/* how much of the file, after any ID3v2 tag, is searched for the first frame;
+ * the decoder would give up on junk data long before this */
+#define PROBE_SIZE 16384
+
+#define ID3V1_SIZE 128
+
+struct FrameHeader
+{
+    int version, layer;
+    int bitrate, rate, channels;
+    int size;    // in bytes, including the header
+    int samples; // per channel
+};
+
+/* in kbit/s, indexed by [version > 0][layer - 1][index] */
+static const short bitrates[2][3][15] = {
+    {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+     {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+     {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}},
+    {{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+     {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+     {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}}};
+
+/* for MPEG-1, halved for MPEG-2 and again for MPEG-2.5 */
+static const int rates[3] = {44100, 48000, 32000};
+
+static uint32_t read_be32(const unsigned char * p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+           p[3];
+}
+
+static bool parse_frame_header(const unsigned char * p, FrameHeader & h)
+{
+    if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0)
+        return false;
+
+    int version_bits = (p[1] >> 3) & 3;
+    int layer_bits = (p[1] >> 1) & 3;
+    int bitrate_index = p[2] >> 4;
+    int rate_index = (p[2] >> 2) & 3;
+    int padding = (p[2] >> 1) & 1;
+
+    /* reserved values, or free format */
+    if (version_bits == 1 || !layer_bits || !bitrate_index ||
+        bitrate_index == 15 || rate_index == 3)
+        return false;
+
+    h.version = (version_bits == 3) ? 0 : (version_bits == 2) ? 1 : 2;
+    h.layer = 4 - layer_bits;
+    h.bitrate = bitrates[h.version > 0][h.layer - 1][bitrate_index];
+    h.rate = rates[rate_index] >> h.version;
+    h.channels = ((p[3] >> 6) == 3) ? 1 : 2;
+
+    if (h.layer == 1)
+    {
+        h.size = (12000 * h.bitrate / h.rate + padding) * 4;
+        h.samples = 384;
+    }
+    else if (h.layer == 3 && h.version > 0)
+    {
+        h.size = 72000 * h.bitrate / h.rate + padding;
+        h.samples = 576;
+    }
+    else
+    {
+        h.size = 144000 * h.bitrate / h.rate + padding;
+        h.samples = 1152;
+    }
+
+    return true;
+}
+
+/* Finds a frame header that is followed by another one of the same kind, as
+ * a single match could just as well be a stray sync word.  Returns the offset
+ * of the first frame, or -1. */
+static int find_first_frame(const unsigned char * buf, int len,
+                            FrameHeader & h)
+{
+    for (int pos = 0; pos + 4 <= len; pos++)
+    {
+        FrameHeader next;
+
+        if (parse_frame_header(buf + pos, h) && pos + h.size + 4 <= len &&
+            parse_frame_header(buf + pos + h.size, next) &&
+            next.version == h.version && next.layer == h.layer &&
+            next.rate == h.rate)
+            return pos;
+    }
+
+    return -1;
+}
+
+/* Looks for a Xing (VBR) or Info (CBR) tag in the first frame, and for the
+ * LAME extension that may follow it.  Returns the number of audio frames, or
+ * -1.  <skip> is set to the encoder delay plus padding, if known. */
+static int64_t parse_xing(const unsigned char * frame, const FrameHeader & h,
+                          int & skip)
+{
+    /* the tag comes after the side info */
+    int side_info = (h.version == 0) ? (h.channels == 1 ? 17 : 32)
+                                     : (h.channels == 1 ? 9 : 17);
+
+    const unsigned char * p = frame + 4 + side_info;
+    const unsigned char * end = frame + h.size;
+
+    if (p + 8 > end || (memcmp(p, "Xing", 4) && memcmp(p, "Info", 4)))
+        return -1;
+
+    uint32_t flags = read_be32(p + 4);
+    p += 8;
+
+    if (!(flags & 1) || p + 4 > end)
+        return -1;
+
+    int64_t frames = read_be32(p);
+
+    /* frames, then bytes, table of contents and quality if present */
+    p += 4 + ((flags & 2) ? 4 : 0) + ((flags & 4) ? 100 : 0) +
+         ((flags & 8) ? 4 : 0);
+
+    /* the encoder name, then fields up to the delay and padding at 21-23 */
+    if (p + 24 <= end && (!memcmp(p, "LAME", 4) || !memcmp(p, "Lavf", 4) ||
+                          !memcmp(p, "Lavc", 4)))
+    {
+        int delay = p[21] << 4 | p[22] >> 4;
+        int padding = (p[22] & 0xf) << 8 | p[23];
+        skip = delay + padding;
+    }
+
+    return frames;
+}
+
+/* VBRI is written by the Fraunhofer encoder at a fixed position */
+static int64_t parse_vbri(const unsigned char * frame, const FrameHeader & h)
+{
+    const unsigned char * p = frame + 4 + 32;
+
+    if (p + 18 > frame + h.size || memcmp(p, "VBRI", 4))
+        return -1;
+
+    return read_be32(p + 14);
+}
+
+/* returns the size of an ID3v2 tag at the current position, or 0 */
+static int64_t id3v2_size(const unsigned char * p)
+{
+    if (memcmp(p, "ID3", 3) || ((p[6] | p[7] | p[8] | p[9]) & 0x80))
+        return 0;
+
+    int64_t size = p[6] << 21 | p[7] << 14 | p[8] << 7 | p[9];
+
+    /* header, plus footer if present */
+    return size + 10 + ((p[5] & 0x10) ? 10 : 0);
+}
+
+static bool has_id3v1(VFSFile & file, int64_t file_size)
+{
+    char tag[3];
+
+    return file_size >= ID3V1_SIZE &&
+           file.fseek(-ID3V1_SIZE, VFS_SEEK_END) == 0 &&
+           file.fread(tag, 1, 3) == 3 && !memcmp(tag, "TAG", 3);
+}
+
+bool mp3_read_header(VFSFile & file, MP3HeaderInfo & info)
+{
+    int64_t file_size = file.fsize();
+    if (file_size < 0 || file.fseek(0, VFS_SEEK_SET) < 0)
+        return false;
+
+    unsigned char buf[PROBE_SIZE];
+    int64_t start = 0;
+
+    if (file.fread(buf, 1, 10) == 10)
+        start = id3v2_size(buf);
+
+    if (file.fseek(start, VFS_SEEK_SET) < 0)
+        return false;
+
+    int len = file.fread(buf, 1, sizeof buf);
+
+    FrameHeader h;
+    int pos = find_first_frame(buf, len, h);
+    if (pos < 0)
+        return false;
+
+    info.version = h.version;
+    info.layer = h.layer;
+    info.rate = h.rate;
+    info.channels = h.channels;
+    info.bitrate = h.bitrate;
+
+    int64_t frames = -1;
+    int skip = 0;
+
+    if (h.layer == 3)
+    {
+        frames = parse_xing(buf + pos, h, skip);
+        if (frames < 0)
+            frames = parse_vbri(buf + pos, h);
+    }
+
+    if (frames >= 0)
+    {
+        /* the tag frame holds no audio, so report on the one after it */
+        FrameHeader next;
+        parse_frame_header(buf + pos + h.size, next);
+        info.bitrate = next.bitrate;
+
+        info.samples = aud::max<int64_t>(frames * h.samples - skip, 0);
+    }
+    else
+    {
+        /* constant bitrate, or at least that is all we can assume */
+        int64_t bytes = file_size - (start + pos);
+        if (has_id3v1(file, file_size))
+            bytes -= ID3V1_SIZE;
+
+        info.samples = aud::max<int64_t>(bytes, 0) * 8 * h.rate /
+                       (h.bitrate * 1000);
+    }
+
+    return true;
+}
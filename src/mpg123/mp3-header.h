@@ -0,0 +1,45 @@
+/*
+ * mp3-header.h
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#ifndef MPG123_MP3_HEADER_H
+#define MPG123_MP3_HEADER_H
+
+#include <stdint.h>
+
+class VFSFile;
+
+// What read_tag() needs to know about an MPEG audio file, found by parsing
+// the header of the first frame and any Xing/Info, LAME or VBRI tag in it,
+// without running the decoder.
+struct MP3HeaderInfo
+{
+    int version;      // 0 for MPEG-1, 1 for MPEG-2, 2 for MPEG-2.5
+    int layer;        // 1 to 3
+    int rate;         // in Hz
+    int channels;     // 1 or 2
+    int bitrate;      // of the first audio frame, in kbit/s
+    int64_t samples;  // length, exact if the file has a Xing or VBRI tag
+};
+
+// Reads <info> from a seekable file, which is left at an arbitrary position.
+// Returns false if no valid frame is found near the start of the file, or if
+// it uses free format, which needs the decoder to work out the frame size.
+bool mp3_read_header(VFSFile & file, MP3HeaderInfo & info);
+
+#endif // MPG123_MP3_HEADER_H
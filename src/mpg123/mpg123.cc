@@ -19,8 +19,12 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
 #include <string.h>
 
+#include <glib.h>
+#include <glib/gstdio.h>
+
 #undef EXPORT
 #include <mpg123.h>
 
@@ -42,6 +46,8 @@
 #include <libaudcore/preferences.h>
 #include <libaudcore/runtime.h>
 
+#include "mp3-header.h"
+
 class MPG123Plugin : public InputPlugin
 {
 public:
@@ -84,6 +90,15 @@ const PreferencesWidget MPG123Plugin::widgets[] = {
 
 const PluginPreferences MPG123Plugin::prefs = {{widgets}};
 
+#define INDEX_CACHE_DIR "mpg123-index"
+#define INDEX_CACHE_MAGIC "AUDMPIX1"
+
+#ifdef S_IRGRP
+#define DIRMODE (S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH)
+#else
+#define DIRMODE (S_IRWXU)
+#endif
+
 #define DECODE_OPTIONS                                                         \
     (MPG123_QUIET | MPG123_GAPLESS | MPG123_SEEKBUFFER | MPG123_FUZZY)
 
@@ -125,6 +140,181 @@ void MPG123Plugin::cleanup()
     mpg123_exit();
 }
 
+/* A full scan reads the whole file to find the exact length and build a seek
+ * index.  The result is kept on disk, one cache file per local file, so that
+ * each file only ever needs to be scanned once.  A cache entry is used only
+ * if the size and modification time of the file are unchanged. */
+struct SeekIndex
+{
+    int64_t samples = -1; // exact length, as found by mpg123_scan()
+    int64_t step = 0;     // frames between entries in <offsets>
+    Index<int64_t> offsets;
+};
+
+static bool file_stamp(const char * filename, int64_t & size, int64_t & mtime)
+{
+    StringBuf path = uri_to_filename(filename);
+    if (!path)
+        return false;
+
+    GStatBuf info;
+    if (g_stat(path, &info) < 0)
+        return false;
+
+    size = info.st_size;
+    mtime = info.st_mtime;
+    return true;
+}
+
+static StringBuf index_cache_path(const char * filename)
+{
+    char * name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, filename, -1);
+    StringBuf path = filename_build(
+        {aud_get_path(AudPath::UserDir), INDEX_CACHE_DIR, name});
+    g_free(name);
+    return path;
+}
+
+/* cache file layout: magic, then size, mtime, samples, step, number of
+ * offsets and length of the URI as native int64s, then the URI and the
+ * offsets as native int64s */
+static bool load_index(const char * filename, SeekIndex & index)
+{
+    int64_t size, mtime;
+    if (!file_stamp(filename, size, mtime))
+        return false;
+
+    char * data;
+    gsize len;
+
+    if (!g_file_get_contents(index_cache_path(filename), &data, &len, nullptr))
+        return false;
+
+    int64_t header[6];
+    int magic_len = strlen(INDEX_CACHE_MAGIC);
+    int64_t uri_len = strlen(filename);
+    bool valid = false;
+
+    if (len >= magic_len + sizeof header &&
+        !memcmp(data, INDEX_CACHE_MAGIC, magic_len))
+    {
+        memcpy(header, data + magic_len, sizeof header);
+
+        const char * uri = data + magic_len + sizeof header;
+        const char * offsets = uri + uri_len;
+
+        valid = (header[0] == size && header[1] == mtime && header[2] >= 0 &&
+                 header[3] > 0 && header[4] > 0 && header[5] == uri_len &&
+                 len == magic_len + sizeof header + uri_len +
+                            header[4] * sizeof(int64_t) &&
+                 !memcmp(uri, filename, uri_len));
+
+        if (valid)
+        {
+            index.samples = header[2];
+            index.step = header[3];
+            index.offsets.resize(header[4]);
+            memcpy(index.offsets.begin(), offsets,
+                   header[4] * sizeof(int64_t));
+        }
+    }
+
+    g_free(data);
+    return valid;
+}
+
+static void save_index(const char * filename, const SeekIndex & index)
+{
+    int64_t size, mtime;
+    if (!file_stamp(filename, size, mtime))
+        return;
+
+    StringBuf dir =
+        filename_build({aud_get_path(AudPath::UserDir), INDEX_CACHE_DIR});
+
+    if (g_mkdir_with_parents(dir, DIRMODE) < 0)
+    {
+        AUDERR("Failed to create %s: %s\n", (const char *)dir,
+               strerror(errno));
+        return;
+    }
+
+    int64_t uri_len = strlen(filename);
+    int64_t header[6] = {size,       mtime, index.samples,
+                         index.step, index.offsets.len(), uri_len};
+    int magic_len = strlen(INDEX_CACHE_MAGIC);
+
+    Index<char> out;
+    out.insert(INDEX_CACHE_MAGIC, -1, magic_len);
+    out.insert((const char *)header, -1, sizeof header);
+    out.insert(filename, -1, uri_len);
+    out.insert((const char *)index.offsets.begin(), -1,
+               index.offsets.len() * sizeof(int64_t));
+
+    /* written to a temporary file and renamed, so that concurrent readers
+     * see either the old entry or the new one */
+    StringBuf path = index_cache_path(filename);
+    GError * error = nullptr;
+
+    if (!g_file_set_contents(path, out.begin(), out.len(), &error))
+    {
+        AUDERR("Failed to write %s: %s\n", (const char *)path,
+               error->message);
+        g_error_free(error);
+    }
+}
+
+/* Called in place of mpg123_scan() on an opened decoder: feeds it a seek index
+ * from the cache, or else scans the file and caches the index it builds.  Sets
+ * <length> to the exact length in samples, if known. */
+static bool scan_with_cache(mpg123_handle * dec, const char * filename,
+                            int64_t & length)
+{
+    SeekIndex index;
+
+    if (load_index(filename, index))
+    {
+        Index<off_t> offsets;
+        offsets.resize(index.offsets.len());
+
+        for (int i = 0; i < offsets.len(); i++)
+            offsets[i] = index.offsets[i];
+
+        if (mpg123_set_index(dec, offsets.begin(), index.step,
+                             offsets.len()) == MPG123_OK)
+        {
+            AUDDBG("Using cached seek index for %s.\n", filename);
+            length = index.samples;
+            return true;
+        }
+    }
+
+    if (mpg123_scan(dec) < 0)
+        return false;
+
+    off_t * offsets;
+    off_t step;
+    size_t fill;
+
+    index.samples = mpg123_length(dec);
+
+    if (index.samples >= 0 &&
+        mpg123_index(dec, &offsets, &step, &fill) == MPG123_OK && step > 0 &&
+        fill > 0)
+    {
+        index.step = step;
+        index.offsets.resize(fill);
+
+        for (size_t i = 0; i < fill; i++)
+            index.offsets[i] = offsets[i];
+
+        save_index(filename, index);
+    }
+
+    length = index.samples;
+    return true;
+}
+
 struct DecodeState
 {
     mpg123_handle * dec = nullptr;
@@ -135,6 +325,7 @@ struct DecodeState
 
     bool valid() const { return dec != nullptr; }
 
+    int64_t length = -1; // exact length in samples, if scanned
     long rate;
     int channels, encoding;
     mpg123_frameinfo info;
@@ -165,7 +356,9 @@ DecodeState::DecodeState(const char * filename, VFSFile & file, bool probing,
     if (mpg123_open_handle(dec, &file) < 0)
         goto err;
 
-    if (!stream && aud_get_bool("mpg123", "full_scan") && mpg123_scan(dec) < 0)
+    /* the exact length is not needed to identify the file */
+    if (!probing && !stream && aud_get_bool("mpg123", "full_scan") &&
+        !scan_with_cache(dec, filename, length))
         goto err;
 
     while (1)
@@ -212,10 +405,10 @@ static bool detect_id3(VFSFile & file)
     return is_id3;
 }
 
-static StringBuf make_format_string(const mpg123_frameinfo * info)
+static StringBuf make_format_string(int version, int layer)
 {
     static const char * vers[] = {"1", "2", "2.5"};
-    return str_printf("MPEG-%s layer %d", vers[info->version], info->layer);
+    return str_printf("MPEG-%s layer %d", vers[version], layer);
 }
 
 bool MPG123Plugin::is_our_file(const char * filename, VFSFile & file)
@@ -232,35 +425,28 @@ bool MPG123Plugin::is_our_file(const char * filename, VFSFile & file)
     if (!s.valid())
         return false;
 
-    auto fmt = make_format_string(&s.info);
+    auto fmt = make_format_string(s.info.version, s.info.layer);
     AUDDBG("Accepted as %s: %s.\n", &fmt[0], filename);
     return true;
 }
 
-static bool read_mpg123_info(const char * filename, VFSFile & file,
-                             Tuple & tuple)
+/* <samples> is the length of the file, or -1 if unknown */
+static void set_tuple_info(Tuple & tuple, int version, int layer, int bitrate,
+                           int channels, int rate, int64_t samples,
+                           int64_t size)
 {
-    int64_t size = file.fsize();
-    bool stream = (size < 0);
+    tuple.set_int(Tuple::Bitrate, bitrate);
+    tuple.set_str(Tuple::Codec, make_format_string(version, layer));
+    tuple.set_int(Tuple::Channels, channels);
 
-    DecodeState s(filename, file, false, stream);
-    if (!s.valid())
-        return false;
-
-    tuple.set_int(Tuple::Bitrate, s.info.bitrate);
-    tuple.set_str(Tuple::Codec, make_format_string(&s.info));
-    tuple.set_int(Tuple::Channels, s.channels);
-
-    const char * chan_str = (s.channels == 2)
+    const char * chan_str = (channels == 2)
                                 ? _("Stereo")
-                                : (s.channels > 2) ? _("Surround") : _("Mono");
-    tuple.set_str(Tuple::Quality,
-                  str_printf("%s, %d Hz", chan_str, (int)s.rate));
+                                : (channels > 2) ? _("Surround") : _("Mono");
+    tuple.set_str(Tuple::Quality, str_printf("%s, %d Hz", chan_str, rate));
 
-    if (!stream && s.rate > 0)
+    if (samples >= 0 && rate > 0)
     {
-        int64_t samples = mpg123_length(s.dec);
-        int length = aud::rescale<int64_t>(samples, s.rate, 1000);
+        int length = aud::rescale<int64_t>(samples, rate, 1000);
 
         if (length > 0)
         {
@@ -268,6 +454,40 @@ static bool read_mpg123_info(const char * filename, VFSFile & file,
             tuple.set_int(Tuple::Bitrate, aud::rdiv<int64_t>(8 * size, length));
         }
     }
+}
+
+static bool read_mpg123_info(const char * filename, VFSFile & file,
+                             Tuple & tuple)
+{
+    int64_t size = file.fsize();
+    bool stream = (size < 0);
+
+    /* Unless an exact length is wanted, the frame headers tell us all we need
+     * to know, and are much quicker to read than it is to start decoding. */
+    if (!stream && !aud_get_bool("mpg123", "full_scan"))
+    {
+        MP3HeaderInfo h;
+        if (mp3_read_header(file, h))
+        {
+            set_tuple_info(tuple, h.version, h.layer, h.bitrate, h.channels,
+                           h.rate, h.samples, size);
+            return true;
+        }
+
+        if (file.fseek(0, VFS_SEEK_SET) < 0)
+            return false;
+    }
+
+    DecodeState s(filename, file, false, stream);
+    if (!s.valid())
+        return false;
+
+    int64_t samples = -1;
+    if (!stream)
+        samples = (s.length >= 0) ? s.length : mpg123_length(s.dec);
+
+    set_tuple_info(tuple, s.info.version, s.info.layer, s.info.bitrate,
+                   s.channels, s.rate, samples, size);
 
     return true;
 }
@@ -0,0 +1,494 @@
+/*
+ * Parametric Equalizer Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+
+#include "../effect-common/effect-params.h"
+
+/* Each band is a second-order IIR ("biquad") filter, designed with the formulas
+ * from Robert Bristow-Johnson's Audio EQ Cookbook, and the bands are applied
+ * one after another.  Rather than running the whole cascade over one channel
+ * at a time, the channels are split into groups of four which are processed
+ * together, one channel in each lane of a SIMD register, so that 8-channel
+ * audio costs only twice as much as stereo.  The coefficients are recomputed
+ * only when the settings (or the sample rate) change. */
+
+#define MAX_BANDS 6
+#define MAX_GAIN 24 /* dB */
+
+/* Bands below this fraction of the sample rate keep their state in double
+ * precision.  Their poles lie so close to the unit circle that the rounding
+ * errors of single precision would be amplified into audible noise. */
+#define PRECISE_BELOW 0.01
+
+enum {
+    BAND_OFF,
+    BAND_PEAK,
+    BAND_LOW_SHELF,
+    BAND_HIGH_SHELF,
+    BAND_LOW_PASS,
+    BAND_HIGH_PASS
+};
+
+#define BAND_DEFAULTS(n, type, freq, q) \
+    "band" #n "_type", aud::numeric_string<type>::str, \
+    "band" #n "_freq", #freq, \
+    "band" #n "_gain", "0", \
+    "band" #n "_q", #q
+
+static const char * const eq_defaults[] = {
+    "preamp", "0",
+    BAND_DEFAULTS (1, BAND_LOW_SHELF, 80, 0.707),
+    BAND_DEFAULTS (2, BAND_PEAK, 250, 1),
+    BAND_DEFAULTS (3, BAND_PEAK, 800, 1),
+    BAND_DEFAULTS (4, BAND_PEAK, 2500, 1),
+    BAND_DEFAULTS (5, BAND_PEAK, 6000, 1),
+    BAND_DEFAULTS (6, BAND_HIGH_SHELF, 12000, 0.707),
+    nullptr
+};
+
+/* the parameters of band <b> start at PARAM_BANDS + b * PARAMS_PER_BAND */
+enum {
+    PARAM_PREAMP,
+    PARAM_BANDS
+};
+
+enum {
+    BAND_TYPE,
+    BAND_FREQ,
+    BAND_GAIN,
+    BAND_Q,
+    PARAMS_PER_BAND
+};
+
+#define BAND_PARAMS(n) \
+    {"band" #n "_type", EffectParam::Int}, \
+    {"band" #n "_freq", EffectParam::Float}, \
+    {"band" #n "_gain", EffectParam::Float}, \
+    {"band" #n "_q", EffectParam::Float}
+
+static const EffectParam eq_param_list[] = {
+    {"preamp", EffectParam::Float},
+    BAND_PARAMS (1),
+    BAND_PARAMS (2),
+    BAND_PARAMS (3),
+    BAND_PARAMS (4),
+    BAND_PARAMS (5),
+    BAND_PARAMS (6)
+};
+
+static EffectParams eq_params ("parametric-eq", eq_param_list);
+
+static void eq_changed ()
+    { effect_settings_changed ("parametric-eq"); }
+
+static const ComboItem band_types[] = {
+    ComboItem (N_("Off"), BAND_OFF),
+    ComboItem (N_("Peak"), BAND_PEAK),
+    ComboItem (N_("Low shelf"), BAND_LOW_SHELF),
+    ComboItem (N_("High shelf"), BAND_HIGH_SHELF),
+    ComboItem (N_("Low pass"), BAND_LOW_PASS),
+    ComboItem (N_("High pass"), BAND_HIGH_PASS)
+};
+
+#define BAND_WIDGETS(n, label) \
+    WidgetLabel (label), \
+    WidgetCombo (N_("Type:"), \
+        WidgetInt ("parametric-eq", "band" #n "_type", eq_changed), \
+        {{band_types}}), \
+    WidgetSpin (N_("Frequency:"), \
+        WidgetFloat ("parametric-eq", "band" #n "_freq", eq_changed), \
+        {20, 20000, 10, N_("Hz")}), \
+    WidgetSpin (N_("Gain:"), \
+        WidgetFloat ("parametric-eq", "band" #n "_gain", eq_changed), \
+        {-MAX_GAIN, MAX_GAIN, 0.5, N_("dB")}), \
+    WidgetSpin (N_("Q:"), \
+        WidgetFloat ("parametric-eq", "band" #n "_q", eq_changed), \
+        {0.1, 10, 0.1})
+
+static const PreferencesWidget eq_widgets[] = {
+    WidgetSpin (N_("Preamp:"),
+        WidgetFloat ("parametric-eq", "preamp", eq_changed),
+        {-MAX_GAIN, MAX_GAIN, 0.5, N_("dB")}),
+    BAND_WIDGETS (1, N_("<b>Band 1</b>")),
+    BAND_WIDGETS (2, N_("<b>Band 2</b>")),
+    BAND_WIDGETS (3, N_("<b>Band 3</b>")),
+    BAND_WIDGETS (4, N_("<b>Band 4</b>")),
+    BAND_WIDGETS (5, N_("<b>Band 5</b>")),
+    BAND_WIDGETS (6, N_("<b>Band 6</b>"))
+};
+
+static const PluginPreferences eq_prefs = {{eq_widgets}};
+
+class ParametricEQ : public EffectPlugin
+{
+public:
+    static constexpr PluginInfo info = {
+        N_("Parametric Equalizer"),
+        PACKAGE,
+        nullptr,
+        & eq_prefs
+    };
+
+    /* order #0: alongside the compressor, before any resampling */
+    constexpr ParametricEQ () : EffectPlugin (info, 0, true) {}
+
+    bool init ();
+    void cleanup ();
+
+    void start (int & channels, int & rate);
+    Index<float> & process (Index<float> & data);
+    bool flush (bool force);
+};
+
+EXPORT ParametricEQ aud_plugin_instance;
+
+/* normalized so that a0 = 1 */
+struct Biquad
+{
+    double b0, b1, b2, a1, a2;
+};
+
+/* a band that actually changes the signal */
+struct Stage
+{
+    int band;
+    Biquad coefs;
+};
+
+static int current_channels, current_rate;
+
+/* converted from the settings on the audio thread */
+static int params_serial;
+static float preamp;
+static Stage stages[MAX_BANDS];
+static int n_stages, n_precise; /* the precise stages come first */
+
+/* s1 and s2 of each channel, for each band (not stage), so that the state of
+ * a band survives changes to the others */
+static Index<double> state;
+
+static bool design (int type, double freq, double gain, double q, Biquad & f)
+{
+    if (type == BAND_OFF || ((type == BAND_PEAK || type == BAND_LOW_SHELF ||
+     type == BAND_HIGH_SHELF) && gain == 0))
+        return false;
+
+    double w0 = 2 * M_PI * aud::min (freq, 0.49 * current_rate) / current_rate;
+    double cosw = cos (w0);
+    double alpha = sin (w0) / (2 * aud::max (q, 0.1));
+    double A = pow (10, gain / 40);
+    double sqA = 2 * sqrt (A) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (type)
+    {
+    case BAND_PEAK:
+        b0 = 1 + alpha * A;
+        b1 = -2 * cosw;
+        b2 = 1 - alpha * A;
+        a0 = 1 + alpha / A;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha / A;
+        break;
+
+    case BAND_LOW_SHELF:
+        b0 = A * ((A + 1) - (A - 1) * cosw + sqA);
+        b1 = 2 * A * ((A - 1) - (A + 1) * cosw);
+        b2 = A * ((A + 1) - (A - 1) * cosw - sqA);
+        a0 = (A + 1) + (A - 1) * cosw + sqA;
+        a1 = -2 * ((A - 1) + (A + 1) * cosw);
+        a2 = (A + 1) + (A - 1) * cosw - sqA;
+        break;
+
+    case BAND_HIGH_SHELF:
+        b0 = A * ((A + 1) + (A - 1) * cosw + sqA);
+        b1 = -2 * A * ((A - 1) + (A + 1) * cosw);
+        b2 = A * ((A + 1) + (A - 1) * cosw - sqA);
+        a0 = (A + 1) - (A - 1) * cosw + sqA;
+        a1 = 2 * ((A - 1) - (A + 1) * cosw);
+        a2 = (A + 1) - (A - 1) * cosw - sqA;
+        break;
+
+    case BAND_LOW_PASS:
+        b0 = b2 = (1 - cosw) / 2;
+        b1 = 1 - cosw;
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+
+    case BAND_HIGH_PASS:
+        b0 = b2 = (1 + cosw) / 2;
+        b1 = -(1 + cosw);
+        a0 = 1 + alpha;
+        a1 = -2 * cosw;
+        a2 = 1 - alpha;
+        break;
+
+    default:
+        return false;
+    }
+
+    f = {b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+    return true;
+}
+
+/* zeroes the state of <band> in every group */
+static void clear_band (int band)
+{
+    int len = ((current_channels + 3) / 4) * 8;
+
+    for (int i = 0; i < len; i ++)
+        state[band * len + i] = 0;
+}
+
+static void convert_settings ()
+{
+    preamp = powf (10, eq_params.get (PARAM_PREAMP) / 20);
+
+    bool was_active[MAX_BANDS] = {};
+    for (int s = 0; s < n_stages; s ++)
+        was_active[stages[s].band] = true;
+
+    Stage precise[MAX_BANDS], fast[MAX_BANDS];
+    int n_fast = 0;
+
+    n_precise = 0;
+
+    for (int b = 0; b < MAX_BANDS; b ++)
+    {
+        int p = PARAM_BANDS + b * PARAMS_PER_BAND;
+        float freq = eq_params.get (p + BAND_FREQ);
+        Biquad coefs;
+
+        if (! design (eq_params.get_int (p + BAND_TYPE), freq,
+         eq_params.get (p + BAND_GAIN), eq_params.get (p + BAND_Q), coefs))
+            continue;
+
+        /* the state left from before the band was switched off belongs to
+         * other coefficients, and would be heard as a click */
+        if (! was_active[b])
+            clear_band (b);
+
+        if (freq < PRECISE_BELOW * current_rate)
+            precise[n_precise ++] = {b, coefs};
+        else
+            fast[n_fast ++] = {b, coefs};
+    }
+
+    n_stages = n_precise + n_fast;
+
+    for (int s = 0; s < n_precise; s ++)
+        stages[s] = precise[s];
+    for (int s = 0; s < n_fast; s ++)
+        stages[n_precise + s] = fast[s];
+}
+
+bool ParametricEQ::init ()
+{
+    aud_config_set_defaults ("parametric-eq", eq_defaults);
+    eq_params.init ();
+    return true;
+}
+
+void ParametricEQ::cleanup ()
+{
+    eq_params.cleanup ();
+    state.clear ();
+}
+
+void ParametricEQ::start (int & channels, int & rate)
+{
+    current_channels = channels;
+    current_rate = rate;
+
+    /* round up to whole groups so that no group needs special handling */
+    int groups = (channels + 3) / 4;
+    state.resize (MAX_BANDS * groups * 4 * 2);
+
+    /* the coefficients depend on the rate, so convert again */
+    params_serial = -1;
+
+    flush (true);
+}
+
+bool ParametricEQ::flush (bool force)
+{
+    for (double & s : state)
+        s = 0;
+
+    return true;
+}
+
+/* Four floats or doubles, mapped by the compiler onto SSE, AVX or NEON
+ * registers.  Loads and stores of samples go through memcpy since a group
+ * may not fill all four lanes. */
+typedef float v4f __attribute__ ((vector_size (16)));
+typedef double v4d __attribute__ ((vector_size (32)));
+
+/* The conversions, like everything else taking a v4d, go through references
+ * so that the (AVX) vectors need not be passed in registers. */
+static inline void narrow (v4f & y, const v4d & x)
+{
+    y = v4f {(float) x[0], (float) x[1], (float) x[2], (float) x[3]};
+}
+
+static inline void widen (v4d & y, v4f x)
+{
+    y = v4d {x[0], x[1], x[2], x[3]};
+}
+
+/* State of the stages of one group, copied out of <state> (which is laid out
+ * as [band][group][lane][s1, s2]) into registers for the length of a block,
+ * together with the coefficients. */
+struct GroupState
+{
+    v4d d_coefs[MAX_BANDS][5], d_s1[MAX_BANDS], d_s2[MAX_BANDS];
+    v4f f_coefs[MAX_BANDS][5], f_s1[MAX_BANDS], f_s2[MAX_BANDS];
+};
+
+static double * band_state (int band, int group)
+    { return & state[(band * ((current_channels + 3) / 4) + group) * 8]; }
+
+static void load_group (GroupState & g, int group)
+{
+    for (int s = 0; s < n_stages; s ++)
+    {
+        const Biquad & c = stages[s].coefs;
+        const double coefs[5] = {c.b0, c.b1, c.b2, c.a1, c.a2};
+        const double * st = band_state (stages[s].band, group);
+
+        for (int k = 0; k < 5; k ++)
+        {
+            g.d_coefs[s][k] = v4d () + coefs[k];
+            g.f_coefs[s][k] = v4f () + (float) coefs[k];
+        }
+
+        for (int lane = 0; lane < 4; lane ++)
+        {
+            g.d_s1[s][lane] = st[lane * 2];
+            g.d_s2[s][lane] = st[lane * 2 + 1];
+        }
+
+        narrow (g.f_s1[s], g.d_s1[s]);
+        narrow (g.f_s2[s], g.d_s2[s]);
+    }
+}
+
+static void save_group (const GroupState & g, int group)
+{
+    for (int s = 0; s < n_stages; s ++)
+    {
+        double * st = band_state (stages[s].band, group);
+        bool precise = (s < n_precise);
+
+        for (int lane = 0; lane < 4; lane ++)
+        {
+            st[lane * 2] = precise ? g.d_s1[s][lane] : g.f_s1[s][lane];
+            st[lane * 2 + 1] = precise ? g.d_s2[s][lane] : g.f_s2[s][lane];
+        }
+    }
+}
+
+/* transposed direct form II, which needs only two state variables */
+template<class V>
+static inline void biquad (V & x, const V (& c)[5], V & s1, V & s2)
+{
+    V y = c[0] * x + s1;
+    s1 = c[1] * x - c[3] * y + s2;
+    s2 = c[2] * x - c[4] * y;
+    x = y;
+}
+
+/* runs the cascade over the <LANES> channels of one group */
+template<int LANES>
+static void process_group (GroupState & g, float * data, int frames)
+{
+    v4f gain = v4f () + preamp;
+
+    for (int i = 0; i < frames; i ++)
+    {
+        float * f = data + i * current_channels;
+        v4f x = v4f ();
+        memcpy (& x, f, LANES * sizeof (float));
+
+        x *= gain;
+
+        if (n_precise)
+        {
+            v4d xd;
+            widen (xd, x);
+
+            for (int s = 0; s < n_precise; s ++)
+                biquad (xd, g.d_coefs[s], g.d_s1[s], g.d_s2[s]);
+
+            narrow (x, xd);
+        }
+
+        for (int s = n_precise; s < n_stages; s ++)
+            biquad (x, g.f_coefs[s], g.f_s1[s], g.f_s2[s]);
+
+        memcpy (f, & x, LANES * sizeof (float));
+    }
+}
+
+Index<float> & ParametricEQ::process (Index<float> & data)
+{
+    if (eq_params.changed (params_serial))
+        convert_settings ();
+
+    if (! n_stages && preamp == 1)
+        return data;
+
+    int frames = data.len () / current_channels;
+    GroupState g;
+
+    for (int c = 0; c < current_channels; c += 4)
+    {
+        int group = c / 4;
+        load_group (g, group);
+
+        switch (aud::min (current_channels - c, 4))
+        {
+        case 1:
+            process_group<1> (g, & data[c], frames);
+            break;
+        case 2:
+            process_group<2> (g, & data[c], frames);
+            break;
+        case 3:
+            process_group<3> (g, & data[c], frames);
+            break;
+        default:
+            process_group<4> (g, & data[c], frames);
+            break;
+        }
+
+        save_group (g, group);
+    }
+
+    return data;
+}
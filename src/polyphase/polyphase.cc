@@ -0,0 +1,585 @@
+/*
+ * Polyphase Resampler Plugin for Audacious
+ * Copyright 2026 Audacious developers
+ *
+ * Based on Sample Rate Converter Plugin:
+ * Copyright 2010-2012 John Lindgren
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions, and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions, and the following disclaimer in the documentation
+ *    provided with the distribution.
+ *
+ * This software is provided "as is" and without any warranty, express or
+ * implied. In no event shall the authors be liable for any damages arising from
+ * the use of this software.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libaudcore/audstrings.h>
+#include <libaudcore/i18n.h>
+#include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+#include <libaudcore/runtime.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_DISPATCH
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+/* The input and output rates are reduced to a ratio L:M of integers.  The
+ * resampler conceptually inserts L - 1 zeroes between input samples, applies a
+ * low-pass filter, and keeps every Mth sample.  Only the filter taps that hit
+ * actual input samples need to be evaluated, and these form L "phases" of a
+ * few dozen taps each.  The phases are precomputed once per ratio (and cached
+ * on disk), so producing an output sample is just one dot product per channel,
+ * which is done with SIMD instructions where available. */
+
+#define MIN_RATE 8000
+#define MAX_RATE 192000
+#define RATE_STEP 50
+
+#define MAX_PHASES 4096
+#define TAP_ALIGN 8 /* taps are padded to a multiple of this */
+
+#define CACHE_MAGIC "AUDPOLY1"
+
+#ifdef S_IRGRP
+#define DIRMODE (S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH)
+#else
+#define DIRMODE (S_IRWXU)
+#endif
+
+enum {
+    QUALITY_LOW,
+    QUALITY_MEDIUM,
+    QUALITY_HIGH,
+    QUALITY_VERY_HIGH,
+    N_QUALITIES
+};
+
+/* taps per phase (before widening for downsampling), relative cutoff, and
+ * Kaiser window parameter for each quality level */
+static const struct {
+    int taps;
+    double cutoff;
+    double beta;
+} quality_params[N_QUALITIES] = {
+    {16, 0.90, 6.0},
+    {32, 0.94, 8.0},
+    {64, 0.96, 10.0},
+    {128, 0.98, 12.0}
+};
+
+class PolyphaseResampler : public EffectPlugin
+{
+public:
+    static const char about[];
+    static const char * const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
+    static constexpr PluginInfo info = {
+        N_("Polyphase Resampler"),
+        PACKAGE,
+        about,
+        & prefs
+    };
+
+    /* order #2: must be before crossfade */
+    constexpr PolyphaseResampler () : EffectPlugin (info, 2, false) {}
+
+    bool init ();
+    void cleanup ();
+
+    void start (int & channels, int & rate);
+    bool flush (bool force);
+    int adjust_delay (int delay);
+
+    Index<float> & process (Index<float> & data)
+        { return resample (data, false); }
+    Index<float> & finish (Index<float> & data, bool end_of_playlist)
+        { return resample (data, true); }
+
+private:
+    Index<float> & resample (Index<float> & data, bool finish);
+};
+
+EXPORT PolyphaseResampler aud_plugin_instance;
+
+const char * const PolyphaseResampler::defaults[] = {
+    "quality", aud::numeric_string<QUALITY_HIGH>::str,
+    "rate", "44100",
+    nullptr
+};
+
+typedef float (* DotFunc) (const float * a, const float * b, int len);
+
+/* filter bank: <phases> rows of <stride> taps, the last few zero */
+static int bank_rate_in, bank_rate_out, bank_quality;
+static int phases, step, taps, stride;
+static Index<float> bank;
+
+static DotFunc dot;
+static bool active;
+static int stored_channels, in_rate;
+
+/* Planar input history for each channel.  <pos> is the input frame at or just
+ * before the next output sample, and <phase> is the fractional position of the
+ * output sample after it, in units of 1/L frames. */
+static Index<float> history[AUD_MAX_CHANNELS];
+static int history_len, pos, phase;
+static Index<float> buffer;
+static int buffer_size;
+
+/* ---- dot product kernels (<len> is a multiple of TAP_ALIGN) ---- */
+
+#if !defined(__SSE2__) && !defined(__ARM_NEON)
+static float dot_generic (const float * a, const float * b, int len)
+{
+    float sum[4] = {0, 0, 0, 0};
+
+    for (int i = 0; i < len; i += 4)
+    {
+        sum[0] += a[i] * b[i];
+        sum[1] += a[i + 1] * b[i + 1];
+        sum[2] += a[i + 2] * b[i + 2];
+        sum[3] += a[i + 3] * b[i + 3];
+    }
+
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+#endif
+
+#ifdef __SSE2__
+static float dot_sse2 (const float * a, const float * b, int len)
+{
+    __m128 sum0 = _mm_setzero_ps ();
+    __m128 sum1 = _mm_setzero_ps ();
+
+    for (int i = 0; i < len; i += 8)
+    {
+        sum0 = _mm_add_ps (sum0, _mm_mul_ps (_mm_loadu_ps (a + i), _mm_loadu_ps (b + i)));
+        sum1 = _mm_add_ps (sum1, _mm_mul_ps (_mm_loadu_ps (a + i + 4), _mm_loadu_ps (b + i + 4)));
+    }
+
+    float sum[4];
+    _mm_storeu_ps (sum, _mm_add_ps (sum0, sum1));
+
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+__attribute__ ((target ("avx2,fma")))
+static float dot_avx2 (const float * a, const float * b, int len)
+{
+    __m256 sum = _mm256_setzero_ps ();
+
+    for (int i = 0; i < len; i += 8)
+        sum = _mm256_fmadd_ps (_mm256_loadu_ps (a + i), _mm256_loadu_ps (b + i), sum);
+
+    __m128 half = _mm_add_ps (_mm256_castps256_ps128 (sum), _mm256_extractf128_ps (sum, 1));
+
+    float out[4];
+    _mm_storeu_ps (out, half);
+
+    return (out[0] + out[1]) + (out[2] + out[3]);
+}
+#endif
+
+#ifdef __ARM_NEON
+static float dot_neon (const float * a, const float * b, int len)
+{
+    float32x4_t sum0 = vdupq_n_f32 (0);
+    float32x4_t sum1 = vdupq_n_f32 (0);
+
+    for (int i = 0; i < len; i += 8)
+    {
+        sum0 = vmlaq_f32 (sum0, vld1q_f32 (a + i), vld1q_f32 (b + i));
+        sum1 = vmlaq_f32 (sum1, vld1q_f32 (a + i + 4), vld1q_f32 (b + i + 4));
+    }
+
+    float sum[4];
+    vst1q_f32 (sum, vaddq_f32 (sum0, sum1));
+
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+#endif
+
+static DotFunc select_dot ()
+{
+#ifdef HAVE_X86_DISPATCH
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma"))
+        return dot_avx2;
+#endif
+
+#if defined(__SSE2__)
+    return dot_sse2;
+#elif defined(__ARM_NEON)
+    return dot_neon;
+#else
+    return dot_generic;
+#endif
+}
+
+/* ---- filter design ---- */
+
+static int gcd (int a, int b)
+{
+    while (b)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/* zeroth-order modified Bessel function of the first kind */
+static double bessel_i0 (double x)
+{
+    double sum = 1, term = 1;
+
+    for (int k = 1; k < 50 && term > sum * 1e-12; k ++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+static void design_bank (int quality)
+{
+    /* when downsampling, lower the cutoff to the output Nyquist frequency and
+     * widen the filter to keep the same transition steepness */
+    double scale = aud::min (1.0, (double) phases / step);
+    double cutoff = quality_params[quality].cutoff * scale;
+    double beta = quality_params[quality].beta;
+
+    taps = (int) ceil (quality_params[quality].taps / scale) & ~1;
+    stride = (taps + TAP_ALIGN - 1) / TAP_ALIGN * TAP_ALIGN;
+
+    int half = taps / 2;
+    double i0_beta = bessel_i0 (beta);
+
+    bank.resize (phases * stride);
+    bank.erase (0, -1);
+
+    for (int p = 0; p < phases; p ++)
+    {
+        float * row = & bank[p * stride];
+        double sum = 0;
+
+        for (int k = 0; k < taps; k ++)
+        {
+            /* distance of this tap from the output sample, in input frames */
+            double x = (k - (half - 1)) - (double) p / phases;
+            double w = x / half;
+            double y = cutoff * x;
+
+            double sinc = (y == 0) ? 1 : sin (M_PI * y) / (M_PI * y);
+            double window = (fabs (w) < 1) ? bessel_i0 (beta * sqrt (1 - w * w)) / i0_beta : 0;
+
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+
+        /* normalize each phase for unity gain at DC */
+        for (int k = 0; k < taps; k ++)
+            row[k] /= sum;
+    }
+}
+
+static StringBuf cache_path (int rate_in, int rate_out, int quality)
+{
+    StringBuf name = str_printf ("%d-%d-%d.bank", rate_in, rate_out, quality);
+    return filename_build ({aud_get_path (AudPath::UserDir), "polyphase", name});
+}
+
+/* cache file layout: magic, then phases, step, taps and stride as native ints,
+ * then phases * stride native floats */
+static bool load_bank (const char * path)
+{
+    char * data;
+    gsize len;
+
+    if (! g_file_get_contents (path, & data, & len, nullptr))
+        return false;
+
+    int header[4];
+    int magic_len = strlen (CACHE_MAGIC);
+    bool valid = false;
+
+    if (len >= magic_len + sizeof header && ! memcmp (data, CACHE_MAGIC, magic_len))
+    {
+        memcpy (header, data + magic_len, sizeof header);
+
+        gsize bank_len = (gsize) header[0] * header[3];
+        valid = (header[0] == phases && header[1] == step && header[2] > 0 &&
+         header[3] >= header[2] && header[3] % TAP_ALIGN == 0 &&
+         len == magic_len + sizeof header + bank_len * sizeof (float));
+
+        if (valid)
+        {
+            taps = header[2];
+            stride = header[3];
+            bank.resize (phases * stride);
+            memcpy (bank.begin (), data + magic_len + sizeof header, bank.len () * sizeof (float));
+        }
+    }
+
+    g_free (data);
+    return valid;
+}
+
+static void save_bank (const char * path)
+{
+    StringBuf dir = filename_build ({aud_get_path (AudPath::UserDir), "polyphase"});
+
+    if (g_mkdir_with_parents (dir, DIRMODE) < 0)
+    {
+        AUDERR ("Failed to create %s: %s\n", (const char *) dir, strerror (errno));
+        return;
+    }
+
+    int header[4] = {phases, step, taps, stride};
+    int magic_len = strlen (CACHE_MAGIC);
+
+    Index<char> out;
+    out.insert (CACHE_MAGIC, -1, magic_len);
+    out.insert ((const char *) header, -1, sizeof header);
+    out.insert ((const char *) bank.begin (), -1, bank.len () * sizeof (float));
+
+    GError * error = nullptr;
+    if (! g_file_set_contents (path, out.begin (), out.len (), & error))
+    {
+        AUDERR ("Failed to write %s: %s\n", path, error->message);
+        g_error_free (error);
+    }
+}
+
+static bool setup_bank (int rate_in, int rate_out, int quality)
+{
+    if (bank.len () && rate_in == bank_rate_in && rate_out == bank_rate_out &&
+     quality == bank_quality)
+        return true;
+
+    int div = gcd (rate_in, rate_out);
+    int new_phases = rate_out / div;
+
+    if (new_phases > MAX_PHASES)
+    {
+        AUDERR ("Conversion from %d to %d Hz is not supported.\n", rate_in, rate_out);
+        return false;
+    }
+
+    phases = new_phases;
+    step = rate_in / div;
+
+    StringBuf path = cache_path (rate_in, rate_out, quality);
+
+    if (! load_bank (path))
+    {
+        design_bank (quality);
+        save_bank (path);
+    }
+
+    bank_rate_in = rate_in;
+    bank_rate_out = rate_out;
+    bank_quality = quality;
+
+    return true;
+}
+
+/* ---- plugin ---- */
+
+bool PolyphaseResampler::init ()
+{
+    aud_config_set_defaults ("polyphase", defaults);
+    dot = select_dot ();
+    return true;
+}
+
+void PolyphaseResampler::cleanup ()
+{
+    active = false;
+
+    bank.clear ();
+    buffer.clear ();
+    buffer_size = 0;
+
+    for (Index<float> & h : history)
+        h.clear ();
+}
+
+void PolyphaseResampler::start (int & channels, int & rate)
+{
+    active = false;
+
+    int new_rate = aud::clamp (aud_get_int ("polyphase", "rate"), MIN_RATE, MAX_RATE);
+    int quality = aud::clamp (aud_get_int ("polyphase", "quality"), 0, N_QUALITIES - 1);
+
+    if (new_rate == rate || ! setup_bank (rate, new_rate, quality))
+        return;
+
+    stored_channels = channels;
+    in_rate = rate;
+    active = true;
+
+    flush (true);
+
+    rate = new_rate;
+}
+
+bool PolyphaseResampler::flush (bool force)
+{
+    if (! active)
+        return true;
+
+    /* pad the start with silence so that the first output sample lines up with
+     * the first input sample */
+    history_len = taps / 2 - 1;
+    pos = history_len;
+    phase = 0;
+
+    for (int c = 0; c < stored_channels; c ++)
+    {
+        history[c].resize (history_len + stride);
+        history[c].erase (0, -1);
+    }
+
+    return true;
+}
+
+Index<float> & PolyphaseResampler::resample (Index<float> & data, bool finish)
+{
+    if (! active)
+        return data;
+
+    int channels = stored_channels;
+    int half = taps / 2;
+    int frames = data.len () / channels;
+
+    /* when finishing, pad the end with silence to flush out the filter */
+    int pad = finish ? half : 0;
+
+    /* append the new input to the history, deinterleaving it; the history is
+     * followed by <stride> samples of slack which the kernels may read */
+    for (int c = 0; c < channels; c ++)
+    {
+        Index<float> & h = history[c];
+        int needed = history_len + frames + pad + stride;
+
+        if (h.len () < needed)
+            h.insert (-1, needed - h.len ());
+
+        const float * in = data.begin () + c;
+        float * out = & h[history_len];
+
+        for (int f = 0; f < frames; f ++)
+            out[f] = in[f * channels];
+
+        for (int f = 0; f < pad; f ++)
+            out[frames + f] = 0;
+    }
+
+    history_len += frames + pad;
+
+    /* work out how many output frames are ready */
+    int64_t avail = history_len - half - pos;
+    int out_frames = (avail > 0) ? (avail * phases - phase + step - 1) / step : 0;
+
+    buffer_size = aud::max (buffer_size, out_frames * channels);
+    buffer.resize (buffer_size);
+
+    float * out = buffer.begin ();
+
+    for (int f = 0; f < out_frames; f ++)
+    {
+        const float * row = & bank[phase * stride];
+        int first = pos - (half - 1);
+
+        for (int c = 0; c < channels; c ++)
+            * out ++ = dot (row, & history[c][first], stride);
+
+        phase += step;
+        pos += phase / phases;
+        phase %= phases;
+    }
+
+    buffer.resize (out_frames * channels);
+
+    /* discard history that is no longer needed */
+    int drop = pos - (half - 1);
+
+    if (drop > 0)
+    {
+        int keep = history_len - drop;
+
+        for (int c = 0; c < channels; c ++)
+            memmove (history[c].begin (), & history[c][drop], sizeof (float) * keep);
+
+        history_len = keep;
+        pos -= drop;
+    }
+
+    if (finish)
+        flush (true);
+
+    return buffer;
+}
+
+int PolyphaseResampler::adjust_delay (int delay)
+{
+    if (! active)
+        return delay;
+
+    /* input frames not yet consumed, as seen from the output side */
+    int pending = history_len - pos;
+    return delay + aud::rescale<int64_t> (pending, in_rate, 1000);
+}
+
+const char PolyphaseResampler::about[] =
+ N_("Polyphase Resampler Plugin for Audacious\n"
+    "Copyright 2026 Audacious developers\n\n"
+    "Based on Sample Rate Converter Plugin:\n"
+    "Copyright 2010-2012 John Lindgren");
+
+static const ComboItem quality_list[] = {
+    ComboItem (N_("Low"), QUALITY_LOW),
+    ComboItem (N_("Medium"), QUALITY_MEDIUM),
+    ComboItem (N_("High"), QUALITY_HIGH),
+    ComboItem (N_("Very High"), QUALITY_VERY_HIGH)
+};
+
+const PreferencesWidget PolyphaseResampler::widgets[] = {
+    WidgetCombo (N_("Quality:"),
+        WidgetInt ("polyphase", "quality"),
+        {{quality_list}}),
+    WidgetSpin (N_("Rate:"),
+        WidgetInt ("polyphase", "rate"),
+        {MIN_RATE, MAX_RATE, RATE_STEP, N_("Hz")})
+};
+
+const PluginPreferences PolyphaseResampler::prefs = {{widgets}};
@@ -82,10 +82,17 @@ const char * const Resampler::defaults[] = {
  "192000", "48000",
  nullptr};
 
+/* The converter state is kept across songs and reused whenever the method,
+ * channel count and ratio are unchanged, so that gapless playback does not
+ * rebuild the filter at every song boundary. */
 static SRC_STATE * state;
-static int stored_channels;
+static bool active;
+static int stored_method, stored_channels;
 static double ratio;
-static Index<float> buffer;
+
+/* libsamplerate writes into a scratch buffer that keeps the largest size
+ * needed so far.  Only the frames it produced are copied to the output. */
+static Index<float> buffer, output;
 
 bool Resampler::init ()
 {
@@ -101,16 +108,15 @@ void Resampler::cleanup ()
         state = nullptr;
     }
 
+    active = false;
+
     buffer.clear ();
+    output.clear ();
 }
 
 void Resampler::start (int & channels, int & rate)
 {
-    if (state)
-    {
-        src_delete (state);
-        state = nullptr;
-    }
+    active = false;
 
     int new_rate = 0;
 
@@ -126,25 +132,46 @@ void Resampler::start (int & channels, int & rate)
         return;
 
     int method = aud_get_int ("resample", "method");
+    double new_ratio = (double) new_rate / rate;
     int error;
 
-    if ((state = src_new (method, channels, & error)) == nullptr)
+    if (state && method == stored_method && channels == stored_channels &&
+     new_ratio == ratio)
     {
-        RESAMPLE_ERROR (error);
-        return;
+        if ((error = src_reset (state)))
+        {
+            RESAMPLE_ERROR (error);
+            return;
+        }
+    }
+    else
+    {
+        if (state)
+            src_delete (state);
+
+        if ((state = src_new (method, channels, & error)) == nullptr)
+        {
+            RESAMPLE_ERROR (error);
+            return;
+        }
+
+        stored_method = method;
+        stored_channels = channels;
+        ratio = new_ratio;
     }
 
-    stored_channels = channels;
-    ratio = (double) new_rate / rate;
+    active = true;
     rate = new_rate;
 }
 
 Index<float> & Resampler::resample (Index<float> & data, bool finish)
 {
-    if (! state || ! data.len ())
+    if (! active || ! data.len ())
         return data;
 
-    buffer.resize ((int) (data.len () * ratio) + 256);
+    int needed = (int) (data.len () * ratio) + 256;
+    if (buffer.len () < needed)
+        buffer.resize (needed);
 
     SRC_DATA d = SRC_DATA ();
 
@@ -162,18 +189,19 @@ Index<float> & Resampler::resample (Index<float> & data, bool finish)
         return data;
     }
 
-    buffer.resize (stored_channels * d.output_frames_gen);
+    output.resize (0);
+    output.insert (buffer.begin (), 0, stored_channels * d.output_frames_gen);
 
     if (finish)
         flush (true);
 
-    return buffer;
+    return output;
 }
 
 bool Resampler::flush (bool force)
 {
     int error;
-    if (state && (error = src_reset (state)))
+    if (active && (error = src_reset (state)))
         RESAMPLE_ERROR (error);
 
     return true;
@@ -0,0 +1 @@
+#include "../effect-common/effect-latency.cc"
@@ -24,6 +24,11 @@
 #include <libaudcore/runtime.h>
 
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../effect-common/effect-latency.h"
+#include "../effect-common/effect-params.h"
 
 #define MAX_BUFFER_SECS  10
 
@@ -50,6 +55,7 @@ public:
     void start (int & channels, int & rate);
     Index<float> & process (Index<float> & data);
     bool flush (bool force);
+    int adjust_delay (int delay);
 };
 
 EXPORT SilenceRemoval aud_plugin_instance;
@@ -60,31 +66,105 @@ const char SilenceRemoval::about[] =
 
 const char * const SilenceRemoval::defaults[] = {
     "threshold", "-40",
+    "rms_gate", "FALSE",
+    "rms_window", "20",
+    "hysteresis", "6",
     nullptr
 };
 
+enum {
+    PARAM_THRESHOLD,
+    PARAM_RMS_GATE,
+    PARAM_RMS_WINDOW,
+    PARAM_HYSTERESIS
+};
+
+static const EffectParam param_list[] = {
+    {"threshold", EffectParam::Int},
+    {"rms_gate", EffectParam::Bool},
+    {"rms_window", EffectParam::Int},
+    {"hysteresis", EffectParam::Int}
+};
+
+static EffectParams params ("silence-removal", param_list);
+
+static void settings_changed ()
+    { effect_settings_changed ("silence-removal"); }
+
+static const PreferencesWidget gate_widgets[] = {
+    WidgetSpin (N_("Window:"),
+        WidgetInt ("silence-removal", "rms_window", settings_changed),
+        {5, 200, 5, N_("ms")}),
+    WidgetSpin (N_("Hysteresis:"),
+        WidgetInt ("silence-removal", "hysteresis", settings_changed),
+        {0, 20, 1, N_("dB")})
+};
+
 const PreferencesWidget SilenceRemoval::widgets[] = {
     WidgetLabel (N_("<b>Silence Removal</b>")),
     WidgetSpin (N_("Threshold:"),
-        WidgetInt ("silence-removal", "threshold"),
-        {-60, -20, 1, N_("dB")})
+        WidgetInt ("silence-removal", "threshold", settings_changed),
+        {-60, -20, 1, N_("dB")}),
+    WidgetCheck (N_("Use RMS gate (trims noisy silence)"),
+        WidgetBool ("silence-removal", "rms_gate", settings_changed)),
+    WidgetTable ({{gate_widgets}},
+        WIDGET_CHILD)
 };
 
 const PluginPreferences SilenceRemoval::prefs = {{widgets}};
 
 static RingBuf<float> buffer;
 static Index<float> output;
-static int current_channels;
+static int current_channels, current_rate;
 static bool initial_silence;
 
+/* settings, converted when changed rather than on every block */
+static int params_serial;
+static float threshold_sq;
+static bool use_gate;
+static float gate_open_sq, gate_close_sq;
+static int gate_window;
+
+/* The RMS gate opens when the mean square level over a window rises above
+ * the threshold, and closes again only once it falls below the threshold
+ * minus the hysteresis. */
+static bool gate_open;
+
+/* trailing silence is held back until it is known whether it will be cut */
+static EffectLatency latency (aud_plugin_instance, "silence-removal");
+
+static void update_latency ()
+{
+    latency.set (buffer.len () / current_channels, current_rate);
+}
+
+static void convert_settings ()
+{
+    float threshold = powf (10.0f, params.get (PARAM_THRESHOLD) / 20.0f);
+    float hysteresis = powf (10.0f, params.get (PARAM_HYSTERESIS) / 20.0f);
+
+    threshold_sq = threshold * threshold;
+
+    use_gate = params.get_bool (PARAM_RMS_GATE);
+    gate_open_sq = threshold_sq;
+    gate_close_sq = threshold_sq / (hysteresis * hysteresis);
+
+    int window_ms = params.get_int (PARAM_RMS_WINDOW);
+    gate_window = aud::max (aud::rescale (window_ms, 1000, current_rate), 1) * current_channels;
+}
+
 bool SilenceRemoval::init ()
 {
     aud_config_set_defaults ("silence-removal", defaults);
+    params.init ();
+    latency.init ();
     return true;
 }
 
 void SilenceRemoval::cleanup ()
 {
+    params.cleanup ();
+    latency.cleanup ();
     buffer.destroy ();
     output.clear ();
 }
@@ -96,7 +176,12 @@ void SilenceRemoval::start (int & channels, int & rate)
     output.resize (0);
 
     current_channels = channels;
+    current_rate = rate;
     initial_silence = true;
+    gate_open = false;
+
+    /* the window depends on the rate, so convert again */
+    params_serial = -1;
 }
 
 static float * align_to_frame (float * begin, float * sample, bool align_to_end)
@@ -111,6 +196,117 @@ static float * align_to_frame (float * begin, float * sample, bool align_to_end)
     return begin + (offset - offset % current_channels);
 }
 
+/* Four floats, mapped by the compiler onto SSE or NEON registers.  Loads go
+ * through memcpy since the data is not necessarily aligned. */
+typedef float v4f __attribute__ ((vector_size (16)));
+typedef int v4i __attribute__ ((vector_size (16)));
+
+static inline v4f load4 (const float * p)
+{
+    v4f v;
+    memcpy (& v, p, sizeof v);
+    return v;
+}
+
+/* whether any of the 16 samples starting at <f> is louder than the threshold;
+ * comparing squares avoids taking the absolute value */
+static inline bool any_loud_16 (const float * f, float limit_sq)
+{
+    v4f limit = {limit_sq, limit_sq, limit_sq, limit_sq};
+    v4f a = load4 (f), b = load4 (f + 4), c = load4 (f + 8), d = load4 (f + 12);
+    v4i loud = (a * a > limit) | (b * b > limit) | (c * c > limit) | (d * d > limit);
+
+    int64_t half[2];
+    memcpy (half, & loud, sizeof half);
+    return (half[0] | half[1]) != 0;
+}
+
+/* Only the edges of the non-silent portion matter, so the block is scanned
+ * inward from either end, 16 samples at a time, stopping at the first loud
+ * group.  The group is then narrowed down to a single sample. */
+static float * first_loud (float * begin, float * end)
+{
+    float * f = begin;
+
+    while (end - f >= 16 && ! any_loud_16 (f, threshold_sq))
+        f += 16;
+
+    for (; f < end; f ++)
+    {
+        if (* f * * f > threshold_sq)
+            return f;
+    }
+
+    return nullptr;
+}
+
+static float * last_loud (float * begin, float * end)
+{
+    float * f = end;
+
+    while (f - begin >= 16 && ! any_loud_16 (f - 16, threshold_sq))
+        f -= 16;
+
+    while (f > begin)
+    {
+        f --;
+        if (* f * * f > threshold_sq)
+            return f;
+    }
+
+    return nullptr;
+}
+
+static float sum_of_squares (const float * f, int len)
+{
+    v4f acc[4] = {v4f (), v4f (), v4f (), v4f ()};
+    int i = 0;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        for (int k = 0; k < 4; k ++)
+        {
+            v4f x = load4 (f + i + 4 * k);
+            acc[k] += x * x;
+        }
+    }
+
+    v4f total = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    float sum = (total[0] + total[1]) + (total[2] + total[3]);
+
+    for (; i < len; i ++)
+        sum += f[i] * f[i];
+
+    return sum;
+}
+
+/* Runs the RMS gate over the block one window at a time.  <first> and <last>
+ * are set to the start of the first and the end of the last window during
+ * which the gate was open; both are already aligned to whole frames. */
+static void gate_scan (float * begin, float * end, float * & first, float * & last)
+{
+    first = last = nullptr;
+
+    for (float * w = begin; w < end; w += gate_window)
+    {
+        int len = aud::min (gate_window, (int) (end - w));
+        float sum = sum_of_squares (w, len);
+
+        if (gate_open)
+            gate_open = (sum >= gate_close_sq * len);
+        else
+            gate_open = (sum > gate_open_sq * len);
+
+        if (gate_open)
+        {
+            if (! first)
+                first = w;
+
+            last = w + len;
+        }
+    }
+}
+
 static void buffer_with_overflow (const float * data, int len)
 {
     int max = buffer.size ();
@@ -133,25 +329,24 @@ static void buffer_with_overflow (const float * data, int len)
 
 Index<float> & SilenceRemoval::process (Index<float> & data)
 {
-    const int threshold_db = aud_get_int ("silence-removal", "threshold");
-    const float threshold = powf (10.0f, threshold_db / 20.0f);
-
     float * first_sample = nullptr;
     float * last_sample = nullptr;
 
-    for (float & sample : data)
+    if (params.changed (params_serial))
+        convert_settings ();
+
+    if (use_gate)
+        gate_scan (data.begin (), data.end (), first_sample, last_sample);
+    else
     {
-        if (sample > threshold || sample < -threshold)
-        {
-            if (! first_sample)
-                first_sample = & sample;
+        first_sample = first_loud (data.begin (), data.end ());
 
-            last_sample = & sample;
-        }
-    }
+        if (first_sample)
+            last_sample = last_loud (first_sample, data.end ());
 
-    first_sample = align_to_frame (data.begin (), first_sample, false);
-    last_sample = align_to_frame (data.begin (), last_sample, true);
+        first_sample = align_to_frame (data.begin (), first_sample, false);
+        last_sample = align_to_frame (data.begin (), last_sample, true);
+    }
 
     output.resize (0);
 
@@ -179,6 +374,7 @@ Index<float> & SilenceRemoval::process (Index<float> & data)
             buffer_with_overflow (data.begin (), data.len ());
     }
 
+    update_latency ();
     return output;
 }
 
@@ -188,5 +384,13 @@ bool SilenceRemoval::flush (bool force)
     output.resize (0);
 
     initial_silence = true;
+    gate_open = false;
+
+    update_latency ();
     return true;
 }
+
+int SilenceRemoval::adjust_delay (int delay)
+{
+    return latency.adjust_delay (delay);
+}
@@ -31,6 +31,7 @@
 #define MIN_RATE 8000
 #define MAX_RATE 192000
 #define RATE_STEP 50
+#define MAX_THREADS 16
 
 class SoXResampler : public EffectPlugin
 {
@@ -68,17 +69,29 @@ const char * const SoXResampler::defaults[] = {
     "allow_aliasing", "FALSE",
 #endif
     "use_steep_filter", "FALSE",
+    "threads", "1",
+    "coef_interp", aud::numeric_string<SOXR_COEF_INTERP_AUTO>::str,
     nullptr
 };
 
+/* The soxr instance is kept across seeks and songs and only cleared, since
+ * building the filter tables is expensive at the higher qualities.  It is
+ * recreated only when the rates, channel count or settings change. */
 static soxr_t soxr;
 static soxr_error_t error;
-static soxr_quality_spec_t q;
+static bool active;
 static int stored_rate;
 static int target_rate;
 static int stored_channels;
+static int stored_recipe;
+static int stored_threads;
+static int stored_interp;
 static double ratio;
-static Index<float> buffer;
+
+/* The resampler writes into a buffer that is only ever grown, to the largest
+ * size needed so far, and the samples produced are copied out of it.  Neither
+ * buffer is resized past its contents, so nothing is zero-filled per call. */
+static Index<float> buffer, output;
 
 bool SoXResampler::init ()
 {
@@ -90,22 +103,22 @@ void SoXResampler::cleanup ()
 {
     soxr_delete (soxr);
     soxr = 0;
+    active = false;
+
     buffer.clear ();
+    output.clear ();
 }
 
 void SoXResampler::start (int & channels, int & rate)
 {
-    soxr_delete (soxr);
-    soxr = 0;
+    active = false;
 
-    target_rate = aud_get_int ("soxr", "rate");
-    target_rate = aud::clamp (target_rate, MIN_RATE, MAX_RATE);
+    int new_rate = aud_get_int ("soxr", "rate");
+    new_rate = aud::clamp (new_rate, MIN_RATE, MAX_RATE);
 
-    if (target_rate == rate)
+    if (new_rate == rate)
         return;
 
-    stored_rate = rate;
-
     int recipe = aud_get_int ("soxr", "quality");
     recipe |= aud_get_int ("soxr", "phase_response");
     recipe |= (aud_get_bool ("soxr", "use_steep_filter")) ? SOXR_STEEP_FILTER : 0;
@@ -113,27 +126,58 @@ void SoXResampler::start (int & channels, int & rate)
     recipe |= (aud_get_bool ("soxr", "allow_aliasing")) ? SOXR_ALLOW_ALIASING : 0;
 #endif
 
-    q = soxr_quality_spec (recipe, 0);
+    int threads = aud::clamp (aud_get_int ("soxr", "threads"), 0, MAX_THREADS);
+    int interp = aud_get_int ("soxr", "coef_interp") & SOXR_COEF_INTERP_MASK;
 
-    soxr = soxr_create (rate, target_rate, channels, & error, nullptr, & q, nullptr);
-
-    if (error)
+    if (soxr && rate == stored_rate && new_rate == target_rate &&
+     channels == stored_channels && recipe == stored_recipe &&
+     threads == stored_threads && interp == stored_interp)
     {
-        AUDERR ("%s\n", error);
-        return;
+        if ((error = soxr_clear (soxr)))
+        {
+            AUDERR ("%s\n", error);
+            return;
+        }
+    }
+    else
+    {
+        soxr_delete (soxr);
+
+        soxr_quality_spec_t q = soxr_quality_spec (recipe, 0);
+        soxr_runtime_spec_t r = soxr_runtime_spec (threads);
+        r.flags = (r.flags & ~SOXR_COEF_INTERP_MASK) | interp;
+
+        soxr = soxr_create (rate, new_rate, channels, & error, nullptr, & q, & r);
+
+        if (error)
+        {
+            AUDERR ("%s\n", error);
+            soxr_delete (soxr);
+            soxr = 0;
+            return;
+        }
+
+        stored_rate = rate;
+        target_rate = new_rate;
+        stored_channels = channels;
+        stored_recipe = recipe;
+        stored_threads = threads;
+        stored_interp = interp;
+        ratio = (double) new_rate / rate;
     }
 
-    stored_channels = channels;
-    ratio = (double) target_rate / rate;
-    rate = target_rate;
+    active = true;
+    rate = new_rate;
 }
 
 Index<float> & SoXResampler::process (Index<float> & data)
 {
-    if (! soxr)
+    if (! active)
          return data;
 
-    buffer.resize ((int) (data.len () * ratio) + 256);
+    int needed = (int) (data.len () * ratio) + 256;
+    if (buffer.len () < needed)
+        buffer.resize (needed);
 
     size_t samples_done;
     error = soxr_process (soxr, data.begin (), data.len () / stored_channels,
@@ -145,25 +189,16 @@ Index<float> & SoXResampler::process (Index<float> & data)
         return data;
     }
 
-    buffer.resize (samples_done * stored_channels);
+    output.resize (0);
+    output.insert (buffer.begin (), 0, samples_done * stored_channels);
 
-    return buffer;
+    return output;
 }
 
 bool SoXResampler::flush (bool force)
 {
-    if (! soxr)
-        return true;
-
-    soxr_delete (soxr);
-
-    soxr = soxr_create (stored_rate, target_rate, stored_channels, & error, nullptr, & q, nullptr);
-
-    if (error)
-    {
+    if (active && (error = soxr_clear (soxr)))
         AUDERR ("%s\n", error);
-        return true;
-    }
 
     return true;
 }
@@ -189,6 +224,12 @@ static const ComboItem phase_response_list[] = {
     ComboItem (N_("Linear"), SOXR_LINEAR_PHASE)
 };
 
+static const ComboItem interp_list[] = {
+    ComboItem (N_("Automatic"), (int) SOXR_COEF_INTERP_AUTO),
+    ComboItem (N_("Low"), (int) SOXR_COEF_INTERP_LOW),
+    ComboItem (N_("High"), (int) SOXR_COEF_INTERP_HIGH)
+};
+
 const PreferencesWidget SoXResampler::widgets[] = {
     WidgetCombo (N_("Quality:"),
         WidgetInt ("soxr", "quality"),
@@ -202,7 +243,14 @@ const PreferencesWidget SoXResampler::widgets[] = {
     WidgetCheck (N_("Use steep filter"), WidgetBool ("soxr", "use_steep_filter")),
     WidgetSpin (N_("Rate:"),
         WidgetInt ("soxr", "rate"),
-        {MIN_RATE, MAX_RATE, RATE_STEP, N_("Hz")})
+        {MIN_RATE, MAX_RATE, RATE_STEP, N_("Hz")}),
+    WidgetLabel (N_("<b>Performance</b>")),
+    WidgetSpin (N_("Threads:"),
+        WidgetInt ("soxr", "threads"),
+        {0, MAX_THREADS, 1, N_("(0 = automatic)")}),
+    WidgetCombo (N_("Coefficient interpolation:"),
+        WidgetInt ("soxr", "coef_interp"),
+        {{interp_list}})
 };
 
 const PluginPreferences SoXResampler::prefs = {{widgets}};
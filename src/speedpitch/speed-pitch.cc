@@ -18,6 +18,7 @@
  */
 
 #include <math.h>
+#include <string.h>
 #include <samplerate.h>
 
 #include <libaudcore/hook.h>
@@ -26,6 +27,9 @@
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/effect-latency.h"
+#include "../effect-common/effect-params.h"
+
 /* The general idea of the speed change algorithm is to divide the input signal
  * into pieces, spaced at a time interval A, using a cosine-shaped window
  * function.  The pieces are then reassembled by adding them together again,
@@ -35,6 +39,22 @@
 #define FREQ    10
 #define OVERLAP  3
 
+/* WSOLA (waveform similarity overlap-add) instead uses Hann windows with 50%
+ * overlap, but rather than taking each piece at exactly interval A, it searches
+ * a small range around that point for the piece that best continues the
+ * previous one, judged by normalized cross-correlation.  This avoids the phasing
+ * artifacts of plain overlap-add.  The search is done first on a decimated
+ * mono mixdown and then refined at full resolution. */
+
+#define WSOLA_FREQ   25 /* windows per second */
+#define WSOLA_SEARCH 100 /* 1 / search radius in seconds */
+#define WSOLA_DECIM  4
+
+enum {
+    METHOD_OLA,
+    METHOD_WSOLA
+};
+
 #define CFGSECT "speed-pitch"
 #define MINSPEED 0.5
 #define MAXSPEED 2.0
@@ -77,6 +97,22 @@ private:
 
 EXPORT SpeedPitch aud_plugin_instance;
 
+enum {
+    PARAM_DECOUPLE,
+    PARAM_SPEED,
+    PARAM_PITCH,
+    PARAM_METHOD
+};
+
+static const EffectParam param_list[] = {
+    {"decouple", EffectParam::Bool},
+    {"speed", EffectParam::Float},
+    {"pitch", EffectParam::Float},
+    {"method", EffectParam::Int}
+};
+
+static EffectParams params (CFGSECT, param_list);
+
 static double semitones;
 static int curchans, currate;
 static SRC_STATE * srcstate;
@@ -85,6 +121,20 @@ static Index<float> cosine;
 static Index<float> in, out;
 static int src, dst;
 
+static int method;
+static int wsola_width, wsola_hop, wsola_radius; /* in frames */
+static int wsola_cont;
+static Index<float> hann, overlap, ref, cand, ref_dec, cand_dec;
+
+/* In WSOLA mode, the input is kept in a ring buffer of ring_size frames,
+ * stored twice over so that any span of up to ring_size frames can be read
+ * without wrapping around.  It only grows when a block arrives that is larger
+ * than any before it. */
+static Index<float> ring;
+static int ring_size, ring_start, ring_len; /* in frames */
+
+static EffectLatency latency (aud_plugin_instance, "speed-pitch");
+
 static void add_data (Index<float> & b, Index<float> & data, float ratio)
 {
     int oldlen = b.len ();
@@ -104,6 +154,110 @@ static void add_data (Index<float> & b, Index<float> & data, float ratio)
     b.resize (oldlen + d.output_frames_gen * curchans);
 }
 
+/* returns the input frame at <pos>, counted from the start of the ring */
+static float * ring_frame (int pos)
+{
+    return & ring[((ring_start + pos) % ring_size) * curchans];
+}
+
+/* copies <frames> frames, written at <pos> in either copy of the ring, to
+ * the other copy */
+static void ring_mirror (int pos, int frames)
+{
+    int first = aud::clamp (ring_size - pos, 0, frames);
+
+    if (first)
+        memcpy (& ring[(pos + ring_size) * curchans], & ring[pos * curchans],
+         sizeof (float) * first * curchans);
+    if (frames > first)
+        memcpy (& ring[(pos + first - ring_size) * curchans],
+         & ring[(pos + first) * curchans], sizeof (float) * (frames - first) * curchans);
+}
+
+/* makes room for <frames> more frames in the ring */
+static void ring_reserve (int frames)
+{
+    if (ring_len + frames <= ring_size)
+        return;
+
+    int new_size = aud::max (ring_len + frames, 2 * ring_size);
+    Index<float> grown;
+    grown.resize (2 * new_size * curchans);
+
+    if (ring_len)
+        memcpy (grown.begin (), ring_frame (0), sizeof (float) * ring_len * curchans);
+
+    ring = std::move (grown);
+    ring_size = new_size;
+    ring_start = 0;
+
+    ring_mirror (0, ring_len);
+}
+
+/* resamples <data> to adjust pitch, straight into the ring */
+static void add_ring_data (Index<float> & data, float ratio)
+{
+    int inframes = data.len () / curchans;
+    int maxframes = (int) (inframes * ratio) + 256;
+    ring_reserve (maxframes);
+
+    int pos = (ring_start + ring_len) % ring_size;
+
+    SRC_DATA d = SRC_DATA ();
+
+    d.data_in = data.begin ();
+    d.input_frames = inframes;
+    d.data_out = & ring[pos * curchans];
+    d.output_frames = maxframes;
+    d.src_ratio = ratio;
+
+    src_process (srcstate, & d);
+
+    ring_mirror (pos, d.output_frames_gen);
+    ring_len += d.output_frames_gen;
+}
+
+/* appends <frames> frames of silence to the ring */
+static void add_ring_silence (int frames)
+{
+    ring_reserve (frames);
+
+    int pos = (ring_start + ring_len) % ring_size;
+    memset (& ring[pos * curchans], 0, sizeof (float) * frames * curchans);
+
+    ring_mirror (pos, frames);
+    ring_len += frames;
+}
+
+/* Audio waiting in the input buffer is played back at the new speed, so the
+ * latency of earlier effects is scaled along with it.  Audio in the output
+ * buffer is not. */
+static void update_latency ()
+{
+    if (! params.get_bool (PARAM_DECOUPLE))
+    {
+        latency.set (0, currate);
+        return;
+    }
+
+    float speed = params.get (PARAM_SPEED);
+    int in_samples, out_samples;
+
+    if (method == METHOD_WSOLA)
+    {
+        in_samples = (ring_len - src) * curchans;
+        out_samples = wsola_hop * curchans;
+    }
+    else
+    {
+        in_samples = in.len () - src;
+        out_samples = dst;
+    }
+
+    int frames = (int) lround ((in_samples * (double) speed + out_samples) / curchans);
+    latency.set (frames, currate, speed);
+}
+
 bool SpeedPitch::flush (bool force)
 {
     src_reset (srcstate);
@@ -119,6 +273,15 @@ bool SpeedPitch::flush (bool force)
      * the width of a cosine window. */
     out.insert (0, width / 2);
 
+    /* In WSOLA mode, the source pointer is in frames and the overlap buffer
+     * holds the second half of the last window, ready to be added to the first
+     * half of the next one.  The continuation pointer gives the input frame at
+     * which that second half began. */
+    wsola_cont = -1;
+    overlap.erase (0, -1);
+    ring_start = ring_len = 0;
+
+    update_latency ();
     return true;
 }
 
@@ -144,21 +307,267 @@ void SpeedPitch::start (int & chans, int & rate)
     for (int i = 0; i < width; i ++)
         cosine[i] = (1.0 - cos (2.0 * M_PI * i / width)) / OVERLAP;
 
+    method = params.get_int (PARAM_METHOD);
+
+    /* The WSOLA buffers are sized once here, so that process() does not need
+     * to allocate anything once they have reached their working size. */
+    wsola_hop = aud::max (WSOLA_DECIM, (currate / WSOLA_FREQ / 2) & ~(WSOLA_DECIM - 1));
+    wsola_width = 2 * wsola_hop;
+    wsola_radius = (currate / WSOLA_SEARCH) & ~(WSOLA_DECIM - 1);
+
+    /* periodic Hann window, which sums to exactly one at 50% overlap */
+    hann.resize (wsola_width);
+    for (int i = 0; i < wsola_width; i ++)
+        hann[i] = 0.5 - 0.5 * cos (2.0 * M_PI * i / wsola_width);
+
+    overlap.resize (wsola_hop * curchans);
+    ref.resize (wsola_hop);
+    cand.resize (2 * wsola_radius + wsola_hop);
+    ref_dec.resize (wsola_hop / WSOLA_DECIM);
+    cand_dec.resize (cand.len () / WSOLA_DECIM);
+
+    ring.clear ();
+    ring_size = ring_start = ring_len = 0;
+
+    if (method == METHOD_WSOLA)
+        ring_reserve (currate / 2 + wsola_width + 2 * wsola_radius);
+
     flush (true);
 }
 
+/* sums the channels of <frames> frames of input, starting at <pos> */
+static void mixdown (float * mono, int pos, int frames)
+{
+    const float * f = ring_frame (pos);
+
+    for (int i = 0; i < frames; i ++)
+    {
+        float sum = 0;
+        for (int c = 0; c < curchans; c ++)
+            sum += * f ++;
+
+        mono[i] = sum;
+    }
+}
+
+static void decimate (float * dec, const float * mono, int frames)
+{
+    for (int i = 0; i < frames / WSOLA_DECIM; i ++)
+        dec[i] = mono[i * WSOLA_DECIM];
+}
+
+/* Four floats, mapped by the compiler onto SSE or NEON registers.  Loads go
+ * through memcpy since the candidates are not aligned. */
+typedef float v4f __attribute__ ((vector_size (16)));
+
+static inline v4f load4 (const float * p)
+{
+    v4f v;
+    memcpy (& v, p, sizeof v);
+    return v;
+}
+
+/* normalized cross-correlation of <ref> with <cand>, computed in one pass
+ * along with the energy of <cand> */
+static float similarity (const float * ref, const float * cand, int len)
+{
+    v4f cross4 = {0, 0, 0, 0}, energy4 = {0, 0, 0, 0};
+    int i = 0;
+
+    for (; i + 4 <= len; i += 4)
+    {
+        v4f r = load4 (ref + i), c = load4 (cand + i);
+        cross4 += r * c;
+        energy4 += c * c;
+    }
+
+    float cross = (cross4[0] + cross4[1]) + (cross4[2] + cross4[3]);
+    float energy = (energy4[0] + energy4[1]) + (energy4[2] + energy4[3]);
+
+    for (; i < len; i ++)
+    {
+        cross += ref[i] * cand[i];
+        energy += cand[i] * cand[i];
+    }
+
+    return cross / sqrtf (energy + 1e-9f);
+}
+
+/* finds the input frame near <pos> that best continues the last window */
+static int wsola_search (int pos, int limit)
+{
+    if (wsola_cont < 0)
+        return pos;
+
+    int lo = aud::max (0, pos - wsola_radius);
+    int hi = aud::min (limit - wsola_width, pos + wsola_radius);
+
+    if (hi <= lo)
+        return aud::clamp (pos, 0, aud::max (0, ring_len - wsola_width));
+
+    /* the natural continuation of the previous window */
+    mixdown (ref.begin (), wsola_cont, wsola_hop);
+    mixdown (cand.begin (), lo, hi - lo + wsola_hop);
+
+    /* coarse search on decimated signals */
+    int dec_len = wsola_hop / WSOLA_DECIM;
+    decimate (ref_dec.begin (), ref.begin (), wsola_hop);
+    decimate (cand_dec.begin (), cand.begin (), hi - lo + wsola_hop);
+
+    int coarse = 0;
+    float best_score = -1e30f;
+
+    for (int d = 0; d <= (hi - lo) / WSOLA_DECIM; d ++)
+    {
+        float score = similarity (ref_dec.begin (), & cand_dec[d], dec_len);
+
+        if (score > best_score)
+        {
+            best_score = score;
+            coarse = d * WSOLA_DECIM;
+        }
+    }
+
+    /* refine at full resolution */
+    int best = coarse;
+    best_score = -1e30f;
+
+    for (int d = aud::max (0, coarse - WSOLA_DECIM + 1);
+     d <= aud::min (hi - lo, coarse + WSOLA_DECIM - 1); d ++)
+    {
+        float score = similarity (ref.begin (), & cand[d], wsola_hop);
+
+        if (score > best_score)
+        {
+            best_score = score;
+            best = d;
+        }
+    }
+
+    return lo + best;
+}
+
+static Index<float> & wsola_process (Index<float> & data, float speed, float pitch, bool ending)
+{
+    int hop_samples = wsola_hop * curchans;
+    int instep = (int) round (wsola_hop * speed / pitch);
+
+    /* Work out how many windows can be copied, and size the output once.
+     * Leave room for the search unless the song is ending, in which case the
+     * input is padded with silence so that every frame of it is covered by a
+     * window. */
+    int end = ring_len;
+    int windows;
+
+    if (ending)
+    {
+        add_ring_silence (wsola_width);
+        windows = (src < end) ? (end - 1 - src) / instep + 1 : 0;
+    }
+    else
+    {
+        int avail = end - wsola_width - wsola_radius;
+        windows = (src <= avail) ? (avail - src) / instep + 1 : 0;
+    }
+
+    data.resize (windows * hop_samples + (ending ? hop_samples : 0));
+    float * out_f = data.begin ();
+
+    /* output frames that hold any of the input, used to drop the padding */
+    int keep = 0;
+
+    for (int w = 0; w < windows; w ++)
+    {
+        /* candidates reaching into the padding are not searched, since their
+         * similarity is only measured over the audio left in them */
+        int pos = wsola_search (src, end);
+        const float * f = ring_frame (pos);
+
+        /* first half of the window overlaps the second half of the last one */
+        for (int i = 0; i < wsola_hop; i ++)
+        {
+            for (int c = 0; c < curchans; c ++)
+                * out_f ++ = overlap[i * curchans + c] + f[i * curchans + c] * hann[i];
+        }
+
+        f += hop_samples;
+
+        for (int i = 0; i < wsola_hop; i ++)
+        {
+            for (int c = 0; c < curchans; c ++)
+                overlap[i * curchans + c] = f[i * curchans + c] * hann[wsola_hop + i];
+        }
+
+        keep = aud::max (keep, w * wsola_hop + aud::clamp (end - pos, 0, wsola_width));
+        wsola_cont = pos + wsola_hop;
+        src += instep;
+    }
+
+    if (ending)
+    {
+        /* let the last window ring out, and start afresh with the next song */
+        for (int i = 0; i < hop_samples; i ++)
+            * out_f ++ = overlap[i];
+
+        data.resize (keep * curchans);
+        overlap.erase (0, -1);
+        ring_start = ring_len = 0;
+        src = 0;
+        wsola_cont = -1;
+
+        return data;
+    }
+
+    /* Discard input that can no longer be reached by the search or by the
+     * continuation of the last window. */
+    int seek = aud::max (0, src - wsola_radius);
+    if (wsola_cont >= 0)
+        seek = aud::min (seek, wsola_cont);
+
+    seek = aud::min (seek, ring_len);
+    ring_start = (ring_start + seek) % ring_size;
+    ring_len -= seek;
+
+    src -= seek;
+    if (wsola_cont >= 0)
+        wsola_cont -= seek;
+
+    return data;
+}
+
 Index<float> & SpeedPitch::process (Index<float> & data, bool ending)
 {
     const float * cosine_center = & cosine[width / 2];
-    float pitch = aud_get_double (CFGSECT, "pitch");
-    float speed = aud_get_double (CFGSECT, "speed");
+    float pitch = params.get (PARAM_PITCH);
+    float speed = params.get (PARAM_SPEED);
+
+    bool decouple = params.get_bool (PARAM_DECOUPLE);
+
+    if (method == METHOD_WSOLA && decouple)
+    {
+        add_ring_data (data, 1.0 / pitch);
+        wsola_process (data, speed, pitch, ending);
+        update_latency ();
+        return data;
+    }
 
     /* Copy the passed audio to the input buffer, scaled to adjust pitch. */
     add_data (in, data, 1.0 / pitch);
 
-    if (! aud_get_bool (CFGSECT, "decouple"))
+    if (! decouple)
     {
+        /* pass on anything left in the ring from before */
+        if (ring_len)
+        {
+            in.insert (ring_frame (0), 0, ring_len * curchans);
+            ring_start = ring_len = 0;
+            src = 0;
+            wsola_cont = -1;
+            overlap.erase (0, -1);
+        }
+
         data = std::move (in);
+        update_latency ();
         return data;
     }
 
@@ -198,20 +607,18 @@ Index<float> & SpeedPitch::process (Index<float> & data, bool ending)
     data.move_from (out, 0, 0, ret, true, true);
     dst -= ret;
 
+    update_latency ();
     return data;
 }
 
 int SpeedPitch::adjust_delay (int delay)
 {
-    if (! aud_get_bool (CFGSECT, "decouple"))
-        return delay;
-
-    float samples_to_ms = 1000.0 / (curchans * currate);
-    float speed = aud_get_double (CFGSECT, "speed");
-    int in_samples = in.len () - src;
-    int out_samples = dst;
+    return latency.adjust_delay (delay);
+}
 
-    return (delay + in_samples * samples_to_ms) * speed + out_samples * samples_to_ms;
+static void settings_changed ()
+{
+    effect_settings_changed (CFGSECT);
 }
 
 static void sync_speed ()
@@ -221,6 +628,8 @@ static void sync_speed ()
         aud_set_double (CFGSECT, "speed", aud_get_double (CFGSECT, "pitch"));
         hook_call ("speed-pitch set speed", nullptr);
     }
+
+    settings_changed ();
 }
 
 static void pitch_changed ()
@@ -241,16 +650,26 @@ const char * const SpeedPitch::defaults[] = {
  "decouple", "TRUE",
  "speed", "1",
  "pitch", "1",
+ "method", aud::numeric_string<METHOD_OLA>::str,
  nullptr};
 
+static const ComboItem method_list[] = {
+    ComboItem (N_("Overlap-add (fastest)"), METHOD_OLA),
+    ComboItem (N_("WSOLA (best quality)"), METHOD_WSOLA)
+};
+
 const PreferencesWidget SpeedPitch::widgets[] = {
     WidgetLabel (N_("<b>Speed</b>")),
     WidgetCheck (N_("Decouple from pitch"),
         WidgetBool (CFGSECT, "decouple", sync_speed)),
     WidgetSpin (N_("Multiplier:"),
-        WidgetFloat (CFGSECT, "speed", nullptr, "speed-pitch set speed"),
+        WidgetFloat (CFGSECT, "speed", settings_changed, "speed-pitch set speed"),
         {MINSPEED, MAXSPEED, 0.05},
         WIDGET_CHILD),
+    WidgetCombo (N_("Method:"),
+        WidgetInt (CFGSECT, "method", settings_changed),
+        {{method_list}},
+        WIDGET_CHILD),
     WidgetLabel (N_("<b>Pitch</b>")),
     WidgetSpin (nullptr,
         WidgetFloat (semitones, semitones_changed, "speed-pitch set semitones"),
@@ -267,11 +686,16 @@ bool SpeedPitch::init ()
 {
     aud_config_set_defaults (CFGSECT, defaults);
     pitch_changed ();
+    params.init ();
+    latency.init ();
     return true;
 }
 
 void SpeedPitch::cleanup ()
 {
+    params.cleanup ();
+    latency.cleanup ();
+
     if (srcstate)
         src_delete (srcstate);
 
@@ -280,4 +704,14 @@ void SpeedPitch::cleanup ()
     cosine.clear ();
     in.clear ();
     out.clear ();
+
+    hann.clear ();
+    overlap.clear ();
+    ref.clear ();
+    cand.clear ();
+    ref_dec.clear ();
+    cand_dec.clear ();
+
+    ring.clear ();
+    ring_size = ring_start = ring_len = 0;
 }
@@ -2,11 +2,17 @@
  * Written by Johan Levin, 1999
  * Modified by John Lindgren, 2009-2012 */
 
+#include <string.h>
+
 #include <libaudcore/i18n.h>
 #include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
 #include <libaudcore/preferences.h>
 
+#include "../effect-common/effect-params.h"
+#include "../effect-common/front-pair.h"
+#include "../effect-common/fused-effects.h"
+
 class ExtraStereo : public EffectPlugin
 {
 public:
@@ -25,6 +31,7 @@ public:
     constexpr ExtraStereo () : EffectPlugin (info, 0, true) {}
 
     bool init ();
+    void cleanup ();
 
     void start (int & channels, int & rate);
     Index<float> & process (Index<float> & data);
@@ -38,47 +45,115 @@ const char ExtraStereo::about[] =
 
 const char * const ExtraStereo::defaults[] = {
  "intensity", "2.5",
+ "multichannel", "FALSE",
  nullptr};
 
+enum {
+    STEREO_INTENSITY,
+    STEREO_MULTICHANNEL
+};
+
+static const EffectParam stereo_param_list[] = {
+    {"intensity", EffectParam::Float},
+    {"multichannel", EffectParam::Bool}
+};
+
+static EffectParams stereo_params ("extra_stereo", stereo_param_list);
+
+static void stereo_changed ()
+    { effect_settings_changed ("extra_stereo"); }
+
 const PreferencesWidget ExtraStereo::widgets[] = {
     WidgetLabel (N_("<b>Extra Stereo</b>")),
     WidgetSpin (N_("Intensity:"),
-        WidgetFloat ("extra_stereo", "intensity"),
-        {0, 10, 0.1})
+        WidgetFloat ("extra_stereo", "intensity", stereo_changed),
+        {0, 10, 0.1}),
+    WidgetCheck (N_("Widen front left/right of surround audio"),
+        WidgetBool ("extra_stereo", "multichannel", stereo_changed))
 };
 
 const PluginPreferences ExtraStereo::prefs = {{widgets}};
 
+static int stereo_channels;
+
+static void stereo_process (float * data, int frames);
+static FusedStage stereo_stage (aud_plugin_instance, stereo_process);
+
 bool ExtraStereo::init ()
 {
     aud_config_set_defaults ("extra_stereo", defaults);
+    stereo_params.init ();
+    fused_register (stereo_stage);
     return true;
 }
 
-static int stereo_channels;
+void ExtraStereo::cleanup ()
+{
+    fused_unregister (stereo_stage);
+    stereo_params.cleanup ();
+}
 
 void ExtraStereo::start (int & channels, int & rate)
 {
     stereo_channels = channels;
+    fused_start (stereo_stage, channels, rate);
 }
 
-Index<float> & ExtraStereo::process(Index<float> & data)
+/* Four floats, mapped by the compiler onto SSE or NEON registers.  Loads and
+ * stores go through memcpy since the data is not necessarily aligned. */
+typedef float v4f __attribute__ ((vector_size (16)));
+
+static inline v4f load4 (const float * p)
 {
-    float value = aud_get_double ("extra_stereo", "intensity");
-    float * f, * end;
-    float center;
+    v4f v;
+    memcpy (& v, p, sizeof v);
+    return v;
+}
+
+static inline void store4 (float * p, v4f v)
+{
+    memcpy (p, & v, sizeof v);
+}
+
+/* With c = (l + r) / 2, each channel x becomes c + (x - c) * value, which is
+ * the same as x * (1 + value) / 2 + y * (1 - value) / 2, where y is the other
+ * channel.  Two frames fit in each vector, with y obtained by swapping the
+ * channels within it. */
+static void stereo_widen (float * data, int frames)
+{
+    float value = stereo_params.get (STEREO_INTENSITY);
+    float a = (1 + value) / 2, b = (1 - value) / 2;
+
+    v4f va = {a, a, a, a}, vb = {b, b, b, b};
+    float * f = data, * end = data + 2 * frames;
 
-    if (stereo_channels != 2)
-        return data;
+    for (; end - f >= 8; f += 8)
+    {
+        v4f x = load4 (f), y = load4 (f + 4);
+        v4f xs = {x[1], x[0], x[3], x[2]};
+        v4f ys = {y[1], y[0], y[3], y[2]};
 
-    end = data.end ();
+        store4 (f, x * va + xs * vb);
+        store4 (f + 4, y * va + ys * vb);
+    }
 
-    for (f = data.begin (); f < end; f += 2)
+    for (; f < end; f += 2)
     {
-        center = (f[0] + f[1]) / 2;
-        f[0] = center + (f[0] - center) * value;
-        f[1] = center + (f[1] - center) * value;
+        float l = f[0], r = f[1];
+        f[0] = l * a + r * b;
+        f[1] = r * a + l * b;
     }
+}
 
+static void stereo_process (float * data, int frames)
+{
+    if (stereo_channels == 2 || (stereo_params.get_bool (STEREO_MULTICHANNEL) &&
+     front_pair_layout (stereo_channels)))
+        front_pair_process (data, stereo_channels, frames, stereo_widen);
+}
+
+Index<float> & ExtraStereo::process (Index<float> & data)
+{
+    fused_process (stereo_stage, data);
     return data;
 }
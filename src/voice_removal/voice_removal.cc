@@ -18,44 +18,144 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include <libaudcore/i18n.h>
+#include <libaudcore/runtime.h>
 #include <libaudcore/plugin.h>
+#include <libaudcore/preferences.h>
+
+#include "../effect-common/effect-params.h"
+#include "../effect-common/front-pair.h"
+#include "../effect-common/fused-effects.h"
 
 class VoiceRemoval : public EffectPlugin
 {
 public:
+    static const char * const defaults[];
+    static const PreferencesWidget widgets[];
+    static const PluginPreferences prefs;
+
     static constexpr PluginInfo info = {
         N_("Voice Removal"),
-        PACKAGE
+        PACKAGE,
+        nullptr,
+        & prefs
     };
 
     constexpr VoiceRemoval () : EffectPlugin (info, 0, true) {}
 
+    bool init ();
+    void cleanup ();
+
     void start (int & channels, int & rate);
     Index<float> & process (Index<float> & data);
 };
 
 EXPORT VoiceRemoval aud_plugin_instance;
 
+const char * const VoiceRemoval::defaults[] = {
+ "multichannel", "FALSE",
+ nullptr};
+
+enum {
+    VOICE_MULTICHANNEL
+};
+
+static const EffectParam voice_param_list[] = {
+    {"multichannel", EffectParam::Bool}
+};
+
+static EffectParams voice_params ("voice_removal", voice_param_list);
+
+static void voice_changed ()
+    { effect_settings_changed ("voice_removal"); }
+
+const PreferencesWidget VoiceRemoval::widgets[] = {
+    WidgetCheck (N_("Apply to front left/right of surround audio"),
+        WidgetBool ("voice_removal", "multichannel", voice_changed))
+};
+
+const PluginPreferences VoiceRemoval::prefs = {{widgets}};
+
 static int voice_channels;
 
+static void voice_process (float * data, int frames);
+static FusedStage voice_stage (aud_plugin_instance, voice_process);
+
+bool VoiceRemoval::init ()
+{
+    aud_config_set_defaults ("voice_removal", defaults);
+    voice_params.init ();
+    fused_register (voice_stage);
+    return true;
+}
+
+void VoiceRemoval::cleanup ()
+{
+    fused_unregister (voice_stage);
+    voice_params.cleanup ();
+}
+
 void VoiceRemoval::start (int & channels, int & rate)
 {
     voice_channels = channels;
+    fused_start (voice_stage, channels, rate);
 }
 
-Index<float> & VoiceRemoval::process (Index<float> & data)
+/* Four floats, mapped by the compiler onto SSE or NEON registers.  Loads and
+ * stores go through memcpy since the data is not necessarily aligned. */
+typedef float v4f __attribute__ ((vector_size (16)));
+
+static inline v4f load4 (const float * p)
+{
+    v4f v;
+    memcpy (& v, p, sizeof v);
+    return v;
+}
+
+static inline void store4 (float * p, v4f v)
 {
-    if (voice_channels != 2)
-        return data;
+    memcpy (p, & v, sizeof v);
+}
 
-    float * end = data.end ();
+/* Both channels become l - r.  Two frames fit in each vector; the difference
+ * is taken against the vector with its channels swapped, and the left result
+ * of each frame is then copied to the right. */
+static void voice_remove (float * data, int frames)
+{
+    float * f = data, * end = data + 2 * frames;
 
-    for (float * f = data.begin (); f < end; f += 2)
+    for (; end - f >= 8; f += 8)
+    {
+        v4f x = load4 (f), y = load4 (f + 4);
+        v4f xs = {x[1], x[0], x[3], x[2]};
+        v4f ys = {y[1], y[0], y[3], y[2]};
+
+        v4f dx = x - xs, dy = y - ys;
+        v4f ox = {dx[0], dx[0], dx[2], dx[2]};
+        v4f oy = {dy[0], dy[0], dy[2], dy[2]};
+
+        store4 (f, ox);
+        store4 (f + 4, oy);
+    }
+
+    for (; f < end; f += 2)
     {
         f[0] -= f[1];
         f[1] = f[0];
     }
+}
 
+static void voice_process (float * data, int frames)
+{
+    if (voice_channels == 2 || (voice_params.get_bool (VOICE_MULTICHANNEL) &&
+     front_pair_layout (voice_channels)))
+        front_pair_process (data, voice_channels, frames, voice_remove);
+}
+
+Index<float> & VoiceRemoval::process (Index<float> & data)
+{
+    fused_process (voice_stage, data);
     return data;
 }